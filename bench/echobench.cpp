@@ -0,0 +1,329 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cost of the echo subprotocols themselves, without sockets and network: server::Echo and client::Echo are created
+ * through their factories on top of a stand-in SubProtocolContext whose connection discards everything written to it.
+ * Messages are fed straight into onMessageStart/onMessageData/onMessageEnd across a matrix of payload sizes, fragment
+ * counts, opcodes and broadcast fan-out widths.
+ *
+ *   echobench [--json]
+ *
+ * Reports ns/message and heap allocations/message, as a table or as JSON for comparing releases. The ECHO_* settings
+ * of the subprotocols apply, e.g. ECHO_STREAMING=1 benchmarks streaming mode.
+ */
+
+#include "subprotocol/client/echo/Echo.h"
+#include "subprotocol/client/echo/EchoFactory.h"
+#include "subprotocol/server/echo/Echo.h"
+#include "subprotocol/server/echo/EchoFactory.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "core/SNodeC.h"
+#include "core/socket/SocketConnection.h"
+#include "web/websocket/SubProtocolContext.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace {
+
+    uint64_t allocations = 0;
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    allocations++;
+
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, [[maybe_unused]] std::size_t size) noexcept {
+    std::free(memory);
+}
+
+namespace echobench {
+
+    namespace server = web::websocket::subprotocol::echo::server;
+    namespace client = web::websocket::subprotocol::echo::client;
+
+    // Writes complete immediately: no backlog ever builds up
+    class NullConnection : public core::socket::SocketConnection {
+    public:
+        void sendToPeer(const char* junk, std::size_t junkLen) override {
+            if (junkLen > 0) {
+                last = junk[junkLen - 1]; // Touch the data like a copy into a write buffer would
+            }
+            total += junkLen;
+        }
+
+        std::size_t getTotalQueued() const override {
+            return total;
+        }
+
+        std::size_t getTotalSent() const override {
+            return total;
+        }
+
+    private:
+        std::size_t total = 0;
+        char last = 0;
+    };
+
+    class Context : public web::websocket::SubProtocolContext {
+    public:
+        void sendMessage([[maybe_unused]] uint8_t opCode, const char* message, std::size_t messageLength) override {
+            connection.sendToPeer(message, messageLength);
+        }
+
+        void sendMessageStart([[maybe_unused]] uint8_t opCode, const char* message, std::size_t messageLength) override {
+            connection.sendToPeer(message, messageLength);
+        }
+
+        void sendMessageFrame(const char* message, std::size_t messageLength) override {
+            connection.sendToPeer(message, messageLength);
+        }
+
+        void sendMessageEnd(const char* message, std::size_t messageLength) override {
+            connection.sendToPeer(message, messageLength);
+        }
+
+        void sendPing([[maybe_unused]] const char* reason, [[maybe_unused]] std::size_t reasonLength) override {
+        }
+
+        void sendClose([[maybe_unused]] uint16_t statusCode,
+                       [[maybe_unused]] const char* reason,
+                       [[maybe_unused]] std::size_t reasonLength) override {
+        }
+
+        core::socket::SocketConnection* getSocketConnection() override {
+            return &connection;
+        }
+
+    private:
+        NullConnection connection;
+    };
+
+    struct Driver {
+        template <typename EchoT>
+        static void connect(EchoT* echo) {
+            echo->onConnected();
+            endOfTick(echo);
+        }
+
+        template <typename EchoT>
+        static void message(EchoT* echo, int opCode, std::string_view payload, std::size_t fragments) {
+            std::size_t fragment = (payload.size() + fragments - 1) / fragments;
+
+            echo->onMessageStart(opCode);
+            for (std::size_t offset = 0; offset < payload.size(); offset += fragment) {
+                echo->onMessageData(payload.data() + offset, std::min(fragment, payload.size() - offset));
+            }
+            echo->onMessageEnd();
+            endOfTick(echo);
+        }
+
+        // What the event loop does once all events of an iteration are dispatched
+        static void endOfTick([[maybe_unused]] server::Echo* echo) {
+            server::Echo::flushAll();
+        }
+
+        static void endOfTick([[maybe_unused]] client::Echo* echo) {
+        }
+
+        template <typename EchoT>
+        static void disconnect(EchoT* echo) {
+            echo->onDisconnected();
+        }
+    };
+
+    struct Result {
+        const char* side;
+        std::size_t payload;
+        std::size_t fragments;
+        int opCode;
+        std::size_t fanOut;
+        double nsPerMessage;
+        double allocationsPerMessage;
+    };
+
+    template <typename EchoT>
+    Result run(const char* side, EchoT* sender, std::size_t payloadSize, std::size_t fragments, int opCode, std::size_t fanOut) {
+        using clock = std::chrono::steady_clock;
+
+        std::string payload(payloadSize, 'x');
+
+        // Keep the total work per case roughly constant
+        std::size_t messages = std::clamp<std::size_t>((std::size_t{256} << 20) / ((payloadSize + 64) * fanOut), 1000, 1000000);
+
+        for (std::size_t i = 0; i < 100; i++) { // Warm up buffer pool and caches
+            Driver::message(sender, opCode, payload, fragments);
+        }
+
+        uint64_t allocationsBefore = allocations;
+        clock::time_point start = clock::now();
+
+        for (std::size_t i = 0; i < messages; i++) {
+            Driver::message(sender, opCode, payload, fragments);
+        }
+
+        double elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        return {side,
+                payloadSize,
+                fragments,
+                opCode,
+                fanOut,
+                elapsed / static_cast<double>(messages),
+                static_cast<double>(allocations - allocationsBefore) / static_cast<double>(messages)};
+    }
+
+    template <typename FactoryT, typename EchoT>
+    class Fleet {
+    public:
+        Fleet(FactoryT* factory, std::size_t size)
+            : factory(factory)
+            , contexts(size) {
+            for (Context& context : contexts) {
+                echos.push_back(factory->createSubProtocol(&context));
+                Driver::connect(echos.back());
+            }
+        }
+
+        ~Fleet() {
+            for (EchoT* echo : echos) {
+                Driver::disconnect(echo);
+                factory->deleteSubProtocol(echo);
+            }
+        }
+
+        EchoT* sender() {
+            return echos.front();
+        }
+
+    private:
+        FactoryT* factory;
+        std::vector<Context> contexts;
+        std::vector<EchoT*> echos;
+    };
+
+    void print(const std::vector<Result>& results, bool json) {
+        if (json) {
+            std::cout << "[\n";
+            for (std::size_t i = 0; i < results.size(); i++) {
+                const Result& result = results[i];
+
+                std::cout << "  {\"side\": \"" << result.side << "\", \"payload\": " << result.payload
+                          << ", \"fragments\": " << result.fragments << ", \"opcode\": \"" << (result.opCode == 2 ? "binary" : "text")
+                          << "\", \"fanout\": " << result.fanOut << ", \"ns_per_message\": " << std::fixed << std::setprecision(1)
+                          << result.nsPerMessage << ", \"allocations_per_message\": " << std::setprecision(3)
+                          << result.allocationsPerMessage << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            std::cout << "]" << std::endl;
+        } else {
+            std::cout << std::left << std::setw(8) << "side" << std::right << std::setw(10) << "payload" << std::setw(10) << "frags"
+                      << std::setw(8) << "opcode" << std::setw(8) << "fanout" << std::setw(14) << "ns/msg" << std::setw(12) << "allocs/msg"
+                      << "\n";
+            for (const Result& result : results) {
+                std::cout << std::left << std::setw(8) << result.side << std::right << std::setw(10) << result.payload << std::setw(10)
+                          << result.fragments << std::setw(8) << (result.opCode == 2 ? "binary" : "text") << std::setw(8) << result.fanOut
+                          << std::setw(14) << std::fixed << std::setprecision(1) << result.nsPerMessage << std::setw(12)
+                          << std::setprecision(3) << result.allocationsPerMessage << "\n";
+            }
+        }
+    }
+
+} // namespace echobench
+
+int main(int argc, char* argv[]) {
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+    if (json) {
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+
+    core::SNodeC::init(argc, argv); // The subprotocols register their ping timers with the event loop
+
+    using ServerFactory = web::websocket::subprotocol::echo::server::EchoFactory;
+    using ClientFactory = web::websocket::subprotocol::echo::client::EchoFactory;
+    using ServerEcho = web::websocket::subprotocol::echo::server::Echo;
+    using ClientEcho = web::websocket::subprotocol::echo::client::Echo;
+
+    std::unique_ptr<ServerFactory> serverFactory(static_cast<ServerFactory*>(echoServerSubProtocolFactory()));
+    std::unique_ptr<ClientFactory> clientFactory(static_cast<ClientFactory*>(echoClientSubProtocolFactory()));
+
+    const std::size_t payloads[] = {16, 1024, 64 * 1024};
+    const std::size_t fragmentCounts[] = {1, 8};
+    const int opCodes[] = {1, 2};
+    const std::size_t fanOuts[] = {1, 16, 256};
+
+    std::vector<echobench::Result> results;
+
+    for (std::size_t fanOut : fanOuts) {
+        echobench::Fleet<ServerFactory, ServerEcho> fleet(serverFactory.get(), fanOut);
+
+        for (std::size_t payload : payloads) {
+            for (std::size_t fragments : fragmentCounts) {
+                for (int opCode : opCodes) {
+                    results.push_back(echobench::run("server", fleet.sender(), payload, fragments, opCode, fanOut));
+                }
+            }
+        }
+    }
+
+    {
+        echobench::Fleet<ClientFactory, ClientEcho> fleet(clientFactory.get(), 1);
+
+        for (std::size_t payload : payloads) {
+            for (std::size_t fragments : fragmentCounts) {
+                for (int opCode : opCodes) {
+                    results.push_back(echobench::run("client", fleet.sender(), payload, fragments, opCode, 1));
+                }
+            }
+        }
+    }
+
+    echobench::print(results, json);
+
+    core::SNodeC::free();
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Memory cost of idle websocket connections over loopback. Starts wsechoserver with idle compaction, opens CONNECTIONS
+# echo connections which stay silent, waits until all of them are compacted and fails if the growth of the server's
+# resident memory per connection exceeds CEILING bytes.
+#
+#   bench/idlememory.sh <build-dir> [CONNECTIONS (100000)] [CEILING (16384)]
+#
+# Needs curl and enough file descriptors (the script raises its soft limit). Each wsechoclient uses its own 127.0.0.x
+# destination, as one source/destination address pair runs out of ephemeral ports long before 100k connections.
+#
+
+set -eu
+
+BUILD=${1:?usage: $0 <build-dir> [connections] [ceiling-bytes]}
+CONNECTIONS=${2:-100000}
+CEILING=${3:-16384}
+
+PER_CLIENT=20000
+IDLE_COMPACT=2
+
+ulimit -n $((CONNECTIONS + 4096))
+
+export ECHO_IDLE_COMPACT=$IDLE_COMPACT
+export ECHO_PING_INTERVAL=60
+export ECHO_PING_TIMEOUT=180
+
+metric() {
+    curl -s http://127.0.0.1:8080/metrics | awk -v name="$1" '$1 == name { print $2 }'
+}
+
+await() { # metric value seconds
+    deadline=$(($(date +%s) + $3))
+    while [ "$(metric "$1")" != "$2" ]; do
+        if [ "$(date +%s)" -ge $deadline ]; then
+            echo "timed out waiting for $1 == $2 (is $(metric "$1"))" >&2
+            exit 1
+        fi
+        sleep 1
+    done
+}
+
+pids=""
+trap 'kill $pids 2>/dev/null || true' EXIT
+
+"$BUILD/wsechoserver" >/dev/null 2>&1 &
+pids="$!"
+sleep 2
+
+before=$(metric echo_resident_bytes)
+
+remaining=$CONNECTIONS
+host=1
+while [ $remaining -gt 0 ]; do
+    connections=$((remaining < PER_CLIENT ? remaining : PER_CLIENT))
+
+    "$BUILD/wsechoclient" --host=127.0.0.$host --connections=$connections --rate=0 --duration=86400 >/dev/null 2>&1 &
+    pids="$pids $!"
+
+    remaining=$((remaining - connections))
+    host=$((host + 1))
+done
+
+await echo_connections "$CONNECTIONS" 300
+await echo_idle_connections "$CONNECTIONS" $((4 * IDLE_COMPACT + 10))
+
+after=$(metric echo_resident_bytes)
+perConnection=$(((after - before) / CONNECTIONS))
+
+echo "idle connections:          $CONNECTIONS"
+echo "resident before:           $before bytes"
+echo "resident idle:             $after bytes"
+echo "bytes per idle connection: $perConnection (ceiling $CEILING)"
+
+[ $perConnection -le "$CEILING" ]
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Protocol overhead per transport. Runs the same open-loop load against one wsechoserver over an AF_UNIX stream socket,
+# plain TCP and TLS, and prints throughput and round trip latency side by side. The unix figures are the cost of the
+# websocket and echo subprotocol layers alone, the difference to tcp and tls is what the network stack and the
+# encryption add on top.
+#
+#   bench/transports.sh <build-dir> [CONNECTIONS (100)] [RATE (20000)] [PAYLOAD (256)] [DURATION (10)]
+#
+# The server's tls instance needs its certificate configured as for any other wsechoserver run.
+#
+
+set -eu
+
+BUILD=${1:?usage: $0 <build-dir> [connections] [rate] [payload] [duration]}
+CONNECTIONS=${2:-100}
+RATE=${3:-20000}
+PAYLOAD=${4:-256}
+DURATION=${5:-10}
+
+SOCKET=${TMPDIR:-/tmp}/wsechoserver-$$.sock
+
+pids=""
+trap 'kill $pids 2>/dev/null || true; rm -f "$SOCKET"' EXIT
+
+"$BUILD/wsechoserver" --unix="$SOCKET" >/dev/null 2>&1 &
+pids="$!"
+sleep 2
+
+run() { # transport options...
+    transport=$1
+    shift
+
+    "$BUILD/wsechoclient" "$@" --connections="$CONNECTIONS" --rate="$RATE" --payload="$PAYLOAD" --latency \
+        --duration="$DURATION" 2>/dev/null | awk -v transport="$transport" '
+        /^messages received:/ { received = substr($4, 2) " msg/s" }
+        /^latency \(us\):/    { gsub(",", ""); p50 = $4; p99 = $6; p999 = $8 }
+        END { printf "%-8s %-24s %10s %10s %10s\n", transport, received, p50, p99, p999 }'
+}
+
+printf "%-8s %-24s %10s %10s %10s\n" transport "received" "p50 us" "p99 us" "p99.9 us"
+run unix --unix="$SOCKET"
+run tcp --host=127.0.0.1
+run tls --tls --host=127.0.0.1
@@ -0,0 +1,109 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of the incremental UTF-8 validation of the echo server, in GB/s on one core.
+ *
+ * Each corpus is fed in fragments of different sizes to show the cost of carrying state across fragment boundaries.
+ * ECHO_UTF8_KERNEL=ssse3|scalar restricts the kernel for comparison.
+ */
+
+#include "subprotocol/server/echo/Utf8Validator.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+using web::websocket::subprotocol::echo::server::Utf8Validator;
+
+static std::string corpus(const std::string& unit, std::size_t size) {
+    std::string text;
+
+    while (text.size() + unit.size() <= size) {
+        text += unit;
+    }
+
+    return text;
+}
+
+static double measure(const std::string& text, std::size_t fragment) {
+    using clock = std::chrono::steady_clock;
+
+    Utf8Validator validator;
+    std::size_t bytes = 0;
+    bool valid = true;
+
+    clock::time_point start = clock::now();
+    clock::duration elapsed{};
+
+    while (elapsed < std::chrono::milliseconds(500)) {
+        validator.reset();
+
+        for (std::size_t offset = 0; offset < text.size(); offset += fragment) {
+            valid &= validator.feed(text.data() + offset, std::min(fragment, text.size() - offset));
+        }
+        valid &= validator.complete();
+
+        bytes += text.size();
+        elapsed = clock::now() - start;
+    }
+
+    if (!valid) {
+        std::cerr << "corpus rejected" << std::endl;
+    }
+
+    return static_cast<double>(bytes) / std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+int main() {
+    const std::size_t size = 1024 * 1024;
+
+    const std::vector<std::pair<std::string, std::string>> corpora = {
+        {"ascii", corpus("{\"user\":\"alice\",\"text\":\"hello world\"} ", size)},
+        {"latin", corpus("Grüße aus Österreich, schöne Zeit! ", size)},
+        {"cjk", corpus("日本語のテキストを検証する。", size)},
+        {"emoji", corpus("ok 😀🚀🎉 ", size)},
+    };
+    const std::vector<std::size_t> fragments = {64, 1024, 16 * 1024, size};
+
+    std::cout << "kernel: " << Utf8Validator::kernel() << "\n";
+    std::cout << std::left << std::setw(8) << "corpus";
+    for (std::size_t fragment : fragments) {
+        std::cout << std::right << std::setw(12) << fragment;
+    }
+    std::cout << "  (fragment bytes, GB/s)\n";
+
+    for (const auto& [name, text] : corpora) {
+        std::cout << std::left << std::setw(8) << name;
+        for (std::size_t fragment : fragments) {
+            std::cout << std::right << std::setw(12) << std::fixed << std::setprecision(2) << measure(text, fragment);
+        }
+        std::cout << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LoadGenerator.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <iostream>
+#include <sys/resource.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    LoadReport& LoadReport::instance() {
+        static LoadReport loadReport;
+
+        return loadReport;
+    }
+
+    void LoadReport::print() const {
+        using web::websocket::subprotocol::echo::client::Replay;
+        using web::websocket::subprotocol::echo::client::Statistics;
+
+        const Statistics& statistics = Statistics::instance();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        std::cout << "duration:           " << seconds << " s" << std::endl;
+        std::cout << "connects:           " << connects << " ok, " << connectFailures << " failed" << std::endl;
+        std::cout << "upgrades:           " << upgrades << " ok, " << upgradeFailures << " failed" << std::endl;
+        std::cout << "messages sent:      " << statistics.messagesSent << " (" << static_cast<double>(statistics.messagesSent) / seconds
+                  << " msg/s, " << static_cast<double>(statistics.bytesSent) / seconds << " B/s)" << std::endl;
+        std::cout << "messages received:  " << statistics.messagesReceived << " ("
+                  << static_cast<double>(statistics.messagesReceived) / seconds << " msg/s, "
+                  << static_cast<double>(statistics.bytesReceived) / seconds << " B/s)" << std::endl;
+
+        const Replay& replay = Replay::instance();
+        if (replay.connectionsReplayed > 0) {
+            std::cout << "replayed:           " << replay.connectionsReplayed << " connections, " << replay.messagesReplayed
+                      << " messages, " << replay.recordsDropped << " records dropped" << std::endl;
+        }
+
+        if (statistics.handshakes.count() > 0) {
+            uint64_t stormStart =
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(started.time_since_epoch()).count());
+            double stormSeconds = static_cast<double>(statistics.lastHandshake - stormStart) / 1e9;
+
+            std::cout << "handshakes:         " << statistics.handshakes.count() << " ("
+                      << static_cast<double>(statistics.handshakes.count()) / stormSeconds << " upgrades/s), " << handshakesAbandoned
+                      << " abandoned" << std::endl;
+            std::cout << "handshake (ms):     p50 " << static_cast<double>(statistics.handshakes.percentile(50)) / 1e6 << ", p99 "
+                      << static_cast<double>(statistics.handshakes.percentile(99)) / 1e6 << ", p99.9 "
+                      << static_cast<double>(statistics.handshakes.percentile(99.9)) / 1e6 << ", max "
+                      << static_cast<double>(statistics.handshakes.max()) / 1e6 << std::endl;
+        }
+
+        const TlsSessionCache& tlsSessionCache = TlsSessionCache::instance();
+        uint64_t tlsHandshakes = tlsSessionCache.full + tlsSessionCache.resumed;
+        if (tlsHandshakes > 0) {
+            std::cout << "tls handshakes:     " << tlsSessionCache.full << " full, " << tlsSessionCache.resumed << " resumed ("
+                      << 100 * static_cast<double>(tlsSessionCache.resumed) / static_cast<double>(tlsHandshakes) << " % hit rate)"
+                      << std::endl;
+            if (tlsSessionCache.full > 0 && tlsSessionCache.resumed > 0) {
+                double fullMedian = static_cast<double>(tlsSessionCache.fullTimes.percentile(50)) / 1e6;
+                double resumedMedian = static_cast<double>(tlsSessionCache.resumedTimes.percentile(50)) / 1e6;
+
+                std::cout << "tls handshake (ms): p50 full " << fullMedian << ", resumed " << resumedMedian << " ("
+                          << 100 * (1 - resumedMedian / fullMedian) << " % less)" << std::endl;
+            }
+        }
+
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        double cpuSeconds = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+                            static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        std::cout << "cpu:                " << cpuSeconds << " s ("
+                  << 1e6 * cpuSeconds / static_cast<double>(std::max<uint64_t>(connects, 1)) << " us per connection)" << std::endl;
+
+        if (statistics.latency.count() > 0) {
+            std::cout << "latency (us):       p50 " << static_cast<double>(statistics.latency.percentile(50)) / 1000 << ", p99 "
+                      << static_cast<double>(statistics.latency.percentile(99)) / 1000 << ", p99.9 "
+                      << static_cast<double>(statistics.latency.percentile(99.9)) / 1000 << ", p99.99 "
+                      << static_cast<double>(statistics.latency.percentile(99.99)) / 1000 << ", max "
+                      << static_cast<double>(statistics.latency.max()) / 1000 << " (" << statistics.latency.count() << " samples)"
+                      << std::endl;
+        }
+    }
+
+    uint64_t steadyNow() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void scheduleLoadEnd(const Options& options) {
+        LoadReport::instance().started = std::chrono::steady_clock::now();
+
+        core::timer::Timer::singleshotTimer(
+            []() -> void {
+                LoadReport::instance().print();
+                core::SNodeC::stop();
+            },
+            options.duration);
+    }
+
+} // namespace echoclient
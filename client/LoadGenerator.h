@@ -0,0 +1,340 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOCLIENT_LOADGENERATOR_H
+#define ECHOCLIENT_LOADGENERATOR_H
+
+#include "Options.h"
+#include "Scenarios.h"
+#include "TlsSessionCache.h"
+
+#include "core/SNodeC.h"
+#include "core/socket/State.h"
+#include "core/timer/Timer.h"
+#include "log/Logger.h"
+#include "subprotocol/client/echo/Replay.h"
+#include "subprotocol/client/echo/Scenario.h"
+#include "subprotocol/client/echo/Statistics.h"
+#include "web/http/legacy/un/Client.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>   // for max
+#include <chrono>      // for steady_clock
+#include <cstddef>     // for std::size_t
+#include <cstdint>     // for uint64_t
+#include <functional>  // for function
+#include <memory>      // for shared_ptr, make_shared
+#include <string>      // for string
+#include <type_traits> // for is_same_v
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    /*
+     * Connection level outcome of a load run. The message level counters are kept by the echo client
+     * subprotocol (web::websocket::subprotocol::echo::client::Statistics).
+     */
+    struct LoadReport {
+        uint64_t connects = 0;
+        uint64_t connectFailures = 0;
+        uint64_t upgrades = 0;
+        uint64_t upgradeFailures = 0;
+        uint64_t handshakesAbandoned = 0; // Connect storm: closed before the subprotocol was up
+
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+        static LoadReport& instance();
+
+        // Prints the report to stdout
+        void print() const;
+    };
+
+    // Stops the event loop after options.duration seconds and prints the report
+    void scheduleLoadEnd(const Options& options);
+
+    // Steady clock in ns, the time base of Statistics::handshaking
+    uint64_t steadyNow();
+
+    // Interval at which a connect storm tops up its handshakes in flight
+    constexpr double STORM_TICK = 0.001;
+
+    // Time left to the echoes of a replay once the whole capture has been sent
+    constexpr double REPLAY_DRAIN = 1;
+
+    // Time scenario scripts get beyond options.duration to finish their last step
+    constexpr double SCENARIO_GRACE = 5;
+
+    template <typename Request, typename Response>
+    void requestEchoUpgrade(const std::shared_ptr<Request>& request) {
+        request->set("Sec-WebSocket-Protocol", "echo");
+
+        request->upgrade("/ws/", "websocket", [](const std::shared_ptr<Request>& req, const std::shared_ptr<Response>& res) -> void {
+            req->upgrade(res, [](const std::string& name) -> void {
+                if (!name.empty()) {
+                    LoadReport::instance().upgrades++;
+                } else {
+                    LoadReport::instance().upgradeFailures++;
+                    web::websocket::subprotocol::echo::client::scenario::Connection::connectFailed();
+                }
+            });
+        });
+    }
+
+    // TLS session reuse and handshake timing, no-ops for plain TCP connections
+    template <typename SocketConnection>
+    void tlsConnect(const SocketConnection* socketConnection) {
+        if constexpr (requires { socketConnection->getSSL(); }) {
+            TlsSessionCache::instance().attach(socketConnection->getSSL());
+        }
+    }
+
+    template <typename SocketConnection>
+    void tlsConnected(const SocketConnection* socketConnection) {
+        if constexpr (requires { socketConnection->getSSL(); }) {
+            TlsSessionCache::instance().completed(socketConnection->getSSL());
+        }
+    }
+
+    template <typename SocketConnection>
+    void tlsDisconnect(const SocketConnection* socketConnection) {
+        if constexpr (requires { socketConnection->getSSL(); }) {
+            TlsSessionCache::instance().abandoned(socketConnection->getSSL());
+        }
+    }
+
+    template <typename SocketAddress>
+    void countConnect(const SocketAddress& socketAddress, const core::socket::State& state) {
+        switch (state) {
+            case core::socket::State::OK:
+                LoadReport::instance().connects++;
+                break;
+            case core::socket::State::DISABLED:
+                break;
+            case core::socket::State::ERROR:
+            case core::socket::State::FATAL:
+                LoadReport::instance().connectFailures++;
+                VLOG(1) << "load: " << socketAddress.toString() << ": " << state.what();
+                break;
+        }
+    }
+
+    // Unix domain clients connect to options.unixPath, the others to options.host and options.port
+    template <typename Client, typename OnStatus>
+    void connectTo(const Client& client, const Options& options, const OnStatus& onStatus) {
+        if constexpr (std::is_same_v<Client, web::http::legacy::un::Client>) {
+            client.connect(options.unixPath, onStatus);
+        } else {
+            client.connect(options.host, options.port, onStatus);
+        }
+    }
+
+    template <typename Client>
+    void startLoad(const Options& options) {
+        using SocketConnection = typename Client::SocketConnection;
+        using Request = typename Client::Request;
+        using Response = typename Client::Response;
+        using SocketAddress = typename Client::SocketAddress;
+
+        TlsSessionCache::instance().reuse = options.resume;
+
+        Client client(
+            options.transport(),
+            tlsConnect<SocketConnection>,
+            tlsConnected<SocketConnection>,
+            tlsDisconnect<SocketConnection>,
+            requestEchoUpgrade<Request, Response>,
+            []([[maybe_unused]] const std::shared_ptr<Request>& request) -> void {
+            });
+
+        for (std::size_t i = 0; i < options.connections; i++) {
+            connectTo(client, options, countConnect<SocketAddress>);
+        }
+
+        scheduleLoadEnd(options);
+    }
+
+    /*
+     * Connect storm, the reconnect wave after a failover: opens options.connections connections with at most
+     * options.concurrency handshakes in flight. A handshake is timed from TCP connect (thus including TLS) until the echo
+     * subprotocol is up, which is where Echo::onConnected completes it. Connections stay open. The report is printed
+     * once all handshakes are done or after options.duration seconds.
+     */
+    template <typename Client>
+    void startStorm(const Options& options) {
+        using SocketConnection = typename Client::SocketConnection;
+        using Request = typename Client::Request;
+        using Response = typename Client::Response;
+        using SocketAddress = typename Client::SocketAddress;
+        using web::websocket::subprotocol::echo::client::Statistics;
+
+        struct Storm {
+            std::size_t launched = 0;
+            std::size_t connecting = 0; // connect() issued, TCP not yet established
+        };
+
+        std::shared_ptr<Storm> storm = std::make_shared<Storm>();
+
+        TlsSessionCache::instance().reuse = options.resume;
+
+        std::shared_ptr<Client> client = std::make_shared<Client>(
+            options.transport(),
+            [](const SocketConnection* socketConnection) -> void {
+                Statistics::instance().handshaking.emplace(socketConnection, steadyNow());
+                tlsConnect(socketConnection);
+            },
+            tlsConnected<SocketConnection>,
+            [](const SocketConnection* socketConnection) -> void {
+                if (Statistics::instance().handshaking.erase(socketConnection) > 0) {
+                    LoadReport::instance().handshakesAbandoned++;
+                }
+                tlsDisconnect(socketConnection);
+            },
+            requestEchoUpgrade<Request, Response>,
+            []([[maybe_unused]] const std::shared_ptr<Request>& request) -> void {
+            });
+
+        scheduleLoadEnd(options);
+
+        core::timer::Timer::intervalTimer(
+            [client, storm, options](const std::function<void()>& stop) -> void {
+                const Statistics& statistics = Statistics::instance();
+
+                while (storm->launched < options.connections &&
+                       storm->connecting + statistics.handshaking.size() < options.concurrency) {
+                    storm->launched++;
+                    storm->connecting++;
+
+                    connectTo(*client, options, [storm](const SocketAddress& socketAddress, const core::socket::State& state) -> void {
+                        storm->connecting--;
+                        countConnect(socketAddress, state);
+                    });
+                }
+
+                if (storm->launched == options.connections && storm->connecting == 0 && statistics.handshaking.empty()) {
+                    stop();
+
+                    LoadReport::instance().print();
+                    core::SNodeC::stop();
+                }
+            },
+            STORM_TICK);
+    }
+
+    /*
+     * Replays the capture options.replay at options.speed times its original pace (Replay). The report is printed once
+     * the capture has been sent completely; options.duration does not apply.
+     */
+    template <typename Client>
+    void startReplay(const Options& options) {
+        using SocketConnection = typename Client::SocketConnection;
+        using Request = typename Client::Request;
+        using Response = typename Client::Response;
+        using SocketAddress = typename Client::SocketAddress;
+        using web::websocket::subprotocol::echo::client::Replay;
+
+        if (!Replay::instance().load(options.replay, options.speed)) {
+            core::SNodeC::stop();
+            return;
+        }
+
+        TlsSessionCache::instance().reuse = options.resume;
+
+        std::shared_ptr<Client> client = std::make_shared<Client>(
+            options.transport(),
+            tlsConnect<SocketConnection>,
+            tlsConnected<SocketConnection>,
+            tlsDisconnect<SocketConnection>,
+            requestEchoUpgrade<Request, Response>,
+            []([[maybe_unused]] const std::shared_ptr<Request>& request) -> void {
+            });
+
+        LoadReport::instance().started = std::chrono::steady_clock::now();
+
+        Replay::instance().start(
+            [client, options]() -> void {
+                connectTo(*client, options, countConnect<SocketAddress>);
+            },
+            []() -> void {
+                core::timer::Timer::singleshotTimer(
+                    []() -> void {
+                        LoadReport::instance().print();
+                        core::SNodeC::stop();
+                    },
+                    REPLAY_DRAIN);
+            });
+    }
+
+    /*
+     * Runs options.connections instances of the scenario script 'script' concurrently (scenario::Script). The report is
+     * printed once all of them have finished, at the latest SCENARIO_GRACE seconds after options.duration.
+     */
+    template <typename Client>
+    void startScenario(const Options& options, ScenarioScript script) {
+        using SocketConnection = typename Client::SocketConnection;
+        using Request = typename Client::Request;
+        using Response = typename Client::Response;
+        using SocketAddress = typename Client::SocketAddress;
+        using web::websocket::subprotocol::echo::client::scenario::Connection;
+        using web::websocket::subprotocol::echo::client::scenario::Script;
+
+        TlsSessionCache::instance().reuse = options.resume;
+
+        std::shared_ptr<Client> client = std::make_shared<Client>(
+            options.transport(),
+            tlsConnect<SocketConnection>,
+            tlsConnected<SocketConnection>,
+            tlsDisconnect<SocketConnection>,
+            requestEchoUpgrade<Request, Response>,
+            []([[maybe_unused]] const std::shared_ptr<Request>& request) -> void {
+            });
+
+        Connection::setConnector([client, options]() -> void {
+            connectTo(*client, options, [](const SocketAddress& socketAddress, const core::socket::State& state) -> void {
+                countConnect(socketAddress, state);
+
+                if (state != core::socket::State::OK) {
+                    Connection::connectFailed();
+                }
+            });
+        });
+
+        std::shared_ptr<bool> reported = std::make_shared<bool>(false);
+        std::function<void()> report = [reported]() -> void {
+            if (!*reported) {
+                *reported = true;
+
+                LoadReport::instance().print();
+                core::SNodeC::stop();
+            }
+        };
+
+        Script::onAllFinished(report);
+        core::timer::Timer::singleshotTimer(report, options.duration + SCENARIO_GRACE);
+
+        LoadReport::instance().started = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < std::max<std::size_t>(options.connections, 1); i++) {
+            script(options, i);
+        }
+    }
+
+} // namespace echoclient
+
+#endif // ECHOCLIENT_LOADGENERATOR_H
@@ -0,0 +1,113 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Options.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    Options Options::parse(int& argc, char* argv[]) {
+        Options options;
+
+        int kept = 1;
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg(argv[i]);
+            std::string value(arg.substr(arg.find('=') != std::string_view::npos ? arg.find('=') + 1 : arg.size()));
+
+            if (arg.starts_with("--connections=")) {
+                options.connections = std::strtoul(value.c_str(), nullptr, 10);
+            } else if (arg.starts_with("--rate=")) {
+                options.rate = std::strtod(value.c_str(), nullptr);
+            } else if (arg.starts_with("--payload=")) {
+                char* end = nullptr;
+                options.payloadMin = std::strtoul(value.c_str(), &end, 10);
+                options.payloadMax = *end == ':' ? std::strtoul(end + 1, nullptr, 10) : options.payloadMin;
+            } else if (arg == "--binary") {
+                options.binary = true;
+            } else if (arg == "--latency") {
+                options.latency = true;
+            } else if (arg.starts_with("--duration=")) {
+                options.duration = std::strtod(value.c_str(), nullptr);
+            } else if (arg == "--storm") {
+                options.storm = true;
+            } else if (arg.starts_with("--concurrency=")) {
+                options.concurrency = std::max<std::size_t>(std::strtoul(value.c_str(), nullptr, 10), 1);
+            } else if (arg == "--tls") {
+                options.tls = true;
+            } else if (arg == "--no-resume") {
+                options.resume = false;
+            } else if (arg.starts_with("--replay=")) {
+                options.replay = value;
+            } else if (arg.starts_with("--speed=")) {
+                options.speed = std::strtod(value.c_str(), nullptr);
+            } else if (arg.starts_with("--scenario=")) {
+                options.scenario = value;
+            } else if (arg.starts_with("--unix=")) {
+                options.unixPath = value;
+            } else if (arg.starts_with("--host=")) {
+                options.host = value;
+            } else if (arg.starts_with("--port=")) {
+                options.port = static_cast<uint16_t>(std::strtoul(value.c_str(), nullptr, 10));
+            } else {
+                argv[kept++] = argv[i];
+            }
+        }
+        argv[kept] = nullptr;
+        argc = kept;
+
+        if (options.port == 0) {
+            options.port = options.tls ? 8088 : 8080;
+        }
+
+        if (options.speed <= 0) {
+            options.speed = 1;
+        }
+
+        if (options.payloadMax < options.payloadMin) {
+            options.payloadMax = options.payloadMin;
+        }
+
+        return options;
+    }
+
+    const char* Options::transport() const {
+        if (!unixPath.empty()) {
+            return "unix";
+        }
+
+        return tls ? "tls" : "legacy";
+    }
+
+    void Options::exportToSubProtocol() const {
+        if (connections > 0 && replay.empty() && scenario.empty()) {
+            setenv("ECHO_RATE", std::to_string(rate / static_cast<double>(connections)).c_str(), 1);
+            setenv("ECHO_PAYLOAD_MIN", std::to_string(payloadMin).c_str(), 1);
+            setenv("ECHO_PAYLOAD_MAX", std::to_string(payloadMax).c_str(), 1);
+            setenv("ECHO_BINARY", binary ? "1" : "0", 1);
+            setenv("ECHO_LATENCY", latency ? "1" : "0", 1);
+        }
+    }
+
+} // namespace echoclient
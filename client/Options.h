@@ -0,0 +1,85 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOCLIENT_OPTIONS_H
+#define ECHOCLIENT_OPTIONS_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <cstdint> // for uint16_t
+#include <string>  // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    /*
+     * Load generator options of wsechoclient. They are consumed from the command line before it is handed over
+     * to SNodeC, all remaining arguments are left untouched.
+     *
+     *   --connections=N        number of concurrent websocket connections (0: single legacy and tls demo connection)
+     *   --rate=R               messages per second, summed up over all connections
+     *   --payload=MIN[:MAX]    payload size in bytes, uniformly distributed between MIN and MAX
+     *   --binary               send binary instead of text messages
+     *   --latency              stamp messages and report the round trip time distribution of their echoes
+     *   --duration=S           test duration in seconds
+     *   --storm                connect storm: open the --connections as fast as possible and report upgrades per second
+     *                          and the handshake latency distribution instead of generating messages
+     *   --concurrency=C        handshakes in flight during a connect storm (default 100)
+     *   --tls                  connect via TLS instead of plain TCP
+     *   --no-resume            full TLS handshake for every connection instead of resuming sessions
+     *   --unix=PATH            connect to the AF_UNIX stream socket PATH of wsechoserver --unix instead of TCP
+     *   --replay=FILE          replay a traffic capture of wsechoserver (ECHO_CAPTURE) instead of generating messages
+     *   --speed=N              replay N times as fast as captured (default 1)
+     *   --scenario=NAME        run --connections instances of a scenario script (client/Scenarios.h) instead of the
+     *                          load generator; --rate then paces the scripts
+     *   --host=HOST            server host
+     *   --port=PORT            server port (default: 8080 legacy, 8088 tls)
+     */
+    struct Options {
+        std::size_t connections = 0;
+        double rate = 0;
+        std::size_t payloadMin = 64;
+        std::size_t payloadMax = 64;
+        bool binary = false;
+        bool latency = false;
+        double duration = 10;
+        bool storm = false;
+        std::size_t concurrency = 100;
+        bool tls = false;
+        bool resume = true;
+        std::string replay;
+        double speed = 1;
+        std::string scenario;
+        std::string unixPath;
+        std::string host = "localhost";
+        uint16_t port = 0;
+
+        static Options parse(int& argc, char* argv[]);
+
+        // "unix", "tls" or "legacy": the client instance name, also used for its SNodeC configuration section
+        [[nodiscard]] const char* transport() const;
+
+        // Hands the per connection settings over to the echo client subprotocol
+        void exportToSubProtocol() const;
+    };
+
+} // namespace echoclient
+
+#endif // ECHOCLIENT_OPTIONS_H
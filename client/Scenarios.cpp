@@ -0,0 +1,176 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scenarios.h"
+
+#include "LoadGenerator.h"
+#include "subprotocol/client/echo/Statistics.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <array>
+#include <charconv>
+#include <optional>
+#include <string_view>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    using web::websocket::subprotocol::echo::client::Statistics;
+    using web::websocket::subprotocol::echo::client::scenario::Connection;
+    using web::websocket::subprotocol::echo::client::scenario::Message;
+    using web::websocket::subprotocol::echo::client::scenario::Script;
+    using web::websocket::subprotocol::echo::client::scenario::sleep;
+
+    // "#<index>:<sequence>:" followed by filler up to the payload size. The server broadcasts, thus scripts pick their
+    // own echoes by the index.
+    static std::string stamp(std::size_t index, std::size_t sequence, std::size_t payload) {
+        std::string message = "#" + std::to_string(index) + ":" + std::to_string(sequence) + ":";
+        message.resize(std::max(message.size(), payload), 'x');
+
+        return message;
+    }
+
+    // Sequence number of one of our own messages, nothing for foreign ones
+    static std::optional<std::size_t> ownSequence(const Message& message, std::size_t index) {
+        std::string_view data(message.data);
+        std::size_t messageIndex = 0;
+        std::size_t sequence = 0;
+
+        if (!data.starts_with('#')) {
+            return std::nullopt;
+        }
+
+        auto [indexEnd, indexError] = std::from_chars(data.data() + 1, data.data() + data.size(), messageIndex);
+        if (indexError != std::errc() || messageIndex != index || indexEnd == data.data() + data.size() || *indexEnd != ':') {
+            return std::nullopt;
+        }
+
+        auto [sequenceEnd, sequenceError] = std::from_chars(indexEnd + 1, data.data() + data.size(), sequence);
+        if (sequenceError != std::errc()) {
+            return std::nullopt;
+        }
+
+        return sequence;
+    }
+
+    static double thinkTime(const Options& options) {
+        return options.rate > 0 ? static_cast<double>(std::max<std::size_t>(options.connections, 1)) / options.rate : 0;
+    }
+
+    static Script pingPong(Options options, std::size_t index) {
+        uint64_t deadline = steadyNow() + static_cast<uint64_t>(options.duration * 1e9);
+
+        Connection connection;
+        if (!co_await connection.connect()) {
+            co_return;
+        }
+
+        for (std::size_t sequence = 0; steadyNow() < deadline; sequence++) {
+            uint64_t sent = steadyNow();
+            co_await connection.send(stamp(index, sequence, options.payloadMin));
+
+            std::optional<Message> message;
+            do {
+                message = co_await connection.nextMessage();
+            } while (message.has_value() && ownSequence(*message, index) != sequence);
+
+            if (!message.has_value()) {
+                co_return;
+            }
+
+            Statistics::instance().latency.record(steadyNow() - sent);
+
+            co_await sleep(thinkTime(options));
+        }
+    }
+
+    static Script pipeline(Options options, std::size_t index) {
+        uint64_t deadline = steadyNow() + static_cast<uint64_t>(options.duration * 1e9);
+        std::array<uint64_t, PIPELINE_DEPTH> sent{};
+
+        Connection connection;
+        if (!co_await connection.connect()) {
+            co_return;
+        }
+
+        for (std::size_t batch = 0; steadyNow() < deadline; batch += PIPELINE_DEPTH) {
+            for (std::size_t i = 0; i < PIPELINE_DEPTH; i++) {
+                sent[i] = steadyNow();
+                co_await connection.send(stamp(index, batch + i, options.payloadMin));
+            }
+
+            for (std::size_t outstanding = PIPELINE_DEPTH; outstanding > 0;) {
+                std::optional<Message> message = co_await connection.nextMessage();
+                if (!message.has_value()) {
+                    co_return;
+                }
+
+                std::optional<std::size_t> sequence = ownSequence(*message, index);
+                if (sequence.has_value() && *sequence >= batch && *sequence < batch + PIPELINE_DEPTH) {
+                    Statistics::instance().latency.record(steadyNow() - sent[*sequence - batch]);
+                    outstanding--;
+                }
+            }
+
+            co_await sleep(thinkTime(options));
+        }
+    }
+
+    static Script churn(Options options, std::size_t index) {
+        uint64_t deadline = steadyNow() + static_cast<uint64_t>(options.duration * 1e9);
+
+        Connection connection;
+        for (std::size_t sequence = 0; steadyNow() < deadline; sequence++) {
+            if (!co_await connection.connect()) {
+                co_await sleep(thinkTime(options));
+                continue;
+            }
+
+            uint64_t sent = steadyNow();
+            co_await connection.send(stamp(index, sequence, options.payloadMin));
+
+            std::optional<Message> message;
+            do {
+                message = co_await connection.nextMessage();
+            } while (message.has_value() && ownSequence(*message, index) != sequence);
+
+            if (message.has_value()) {
+                Statistics::instance().latency.record(steadyNow() - sent);
+            }
+
+            connection.close();
+
+            co_await sleep(thinkTime(options));
+        }
+    }
+
+    ScenarioScript findScenario(const std::string& name) {
+        if (name == "pingpong") {
+            return pingPong;
+        } else if (name == "pipeline") {
+            return pipeline;
+        } else if (name == "churn") {
+            return churn;
+        }
+
+        return nullptr;
+    }
+
+} // namespace echoclient
@@ -0,0 +1,51 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOCLIENT_SCENARIOS_H
+#define ECHOCLIENT_SCENARIOS_H
+
+#include "Options.h"
+#include "subprotocol/client/echo/Scenario.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <string>  // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    /*
+     * Built-in scenario scripts, selected by --scenario=NAME. Every script runs on its own connection(s) until
+     * options.duration has passed; 'index' numbers the concurrently running scripts.
+     *
+     *   pingpong   one message in flight: send, wait for its echo, think for connections / rate seconds
+     *   pipeline   PIPELINE_DEPTH messages in flight, the next batch is sent once all echoes are back
+     *   churn      connect, one round trip, close, and again
+     */
+    using ScenarioScript = web::websocket::subprotocol::echo::client::scenario::Script (*)(Options options, std::size_t index);
+
+    // nullptr for unknown names
+    ScenarioScript findScenario(const std::string& name);
+
+    constexpr std::size_t PIPELINE_DEPTH = 16;
+
+} // namespace echoclient
+
+#endif // ECHOCLIENT_SCENARIOS_H
@@ -0,0 +1,113 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TlsSessionCache.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <chrono>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    TlsSessionCache& TlsSessionCache::instance() {
+        static TlsSessionCache tlsSessionCache;
+
+        return tlsSessionCache;
+    }
+
+    TlsSessionCache::~TlsSessionCache() {
+        for (SSL_SESSION* session : sessions) {
+            SSL_SESSION_free(session);
+        }
+    }
+
+    void TlsSessionCache::attach(SSL* ssl) {
+        started[ssl] = now();
+
+        if (!reuse) {
+            return;
+        }
+
+        SSL_CTX* ctx = SSL_get_SSL_CTX(ssl);
+        if (ctx != configured) {
+            configured = ctx;
+
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(ctx, onNewSession);
+        }
+
+        if (!sessions.empty()) {
+            SSL_SESSION* session = sessions.back();
+
+            SSL_set_session(ssl, session); // Takes its own reference
+
+            if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION) {
+                sessions.pop_back();
+                SSL_SESSION_free(session);
+            }
+        }
+    }
+
+    void TlsSessionCache::completed(SSL* ssl) {
+        auto start = started.find(ssl);
+        if (start == started.end()) {
+            return;
+        }
+
+        uint64_t duration = now() - start->second;
+        started.erase(start);
+
+        if (SSL_session_reused(ssl) != 0) {
+            resumed++;
+            resumedTimes.record(duration);
+        } else {
+            full++;
+            fullTimes.record(duration);
+        }
+    }
+
+    void TlsSessionCache::abandoned(SSL* ssl) {
+        started.erase(ssl);
+    }
+
+    int TlsSessionCache::onNewSession([[maybe_unused]] SSL* ssl, SSL_SESSION* session) {
+        std::vector<SSL_SESSION*>& sessions = instance().sessions;
+
+        if (SSL_SESSION_get_protocol_version(session) < TLS1_3_VERSION) { // Reusable: the newest one is all we need
+            for (SSL_SESSION* old : sessions) {
+                SSL_SESSION_free(old);
+            }
+            sessions.clear();
+        } else if (sessions.size() == MAX_SESSIONS) {
+            SSL_SESSION_free(sessions.front());
+            sessions.erase(sessions.begin());
+        }
+
+        sessions.push_back(session);
+
+        return 1; // We keep the reference
+    }
+
+} // namespace echoclient
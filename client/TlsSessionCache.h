@@ -0,0 +1,84 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOCLIENT_TLSSESSIONCACHE_H
+#define ECHOCLIENT_TLSSESSIONCACHE_H
+
+#include "subprotocol/client/echo/Histogram.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef>       // for std::size_t
+#include <cstdint>       // for uint64_t
+#include <openssl/ssl.h> // IWYU pragma: keep
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoclient {
+
+    /*
+     * Client side TLS session reuse for the load and storm modes. Sessions handed out by the server are collected and
+     * offered by new connections, TLS 1.3 ones only once (RFC 8446, C.4): the server issues a fresh ticket with every
+     * handshake, so the stock is replenished as fast as it is used up. TLS 1.2 sessions are reused until replaced.
+     *
+     * Full and resumed handshakes are timed separately from TCP connect to handshake completion. Against a loopback
+     * server this time is almost entirely spent in the key exchange and certificate operations of both ends.
+     */
+    class TlsSessionCache {
+    public:
+        static TlsSessionCache& instance();
+
+        ~TlsSessionCache();
+
+        TlsSessionCache(const TlsSessionCache&) = delete;
+        TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+        // Before the handshake: offers a cached session unless reuse is disabled
+        void attach(SSL* ssl);
+
+        // After the handshake
+        void completed(SSL* ssl);
+
+        void abandoned(SSL* ssl);
+
+        bool reuse = true;
+
+        uint64_t full = 0;
+        uint64_t resumed = 0;
+
+        // Handshake times in ns
+        web::websocket::subprotocol::echo::client::Histogram fullTimes;
+        web::websocket::subprotocol::echo::client::Histogram resumedTimes;
+
+    private:
+        TlsSessionCache() = default;
+
+        static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+        static constexpr std::size_t MAX_SESSIONS = 1024;
+
+        SSL_CTX* configured = nullptr;
+        std::vector<SSL_SESSION*> sessions;
+        std::unordered_map<const SSL*, uint64_t> started;
+    };
+
+} // namespace echoclient
+
+#endif // ECHOCLIENT_TLSSESSIONCACHE_H
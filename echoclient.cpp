@@ -16,12 +16,18 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "client/LoadGenerator.h"
+#include "client/Options.h"
+#include "subprotocol/client/echo/EchoFactory.h"
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
-#include "core/SNodeC.h"               // for SNodeC
-#include "log/Logger.h"                // for Writer, Storage
-#include "web/http/legacy/in/Client.h" // for Client, Client<>...
-#include "web/http/tls/in/Client.h"    // for Client, Client<>...
+#include "core/SNodeC.h"                                     // for SNodeC
+#include "log/Logger.h"                                      // for Writer, Storage
+#include "web/http/legacy/in/Client.h"                       // for Client, Client<>...
+#include "web/http/legacy/un/Client.h"                       // for Client, Client<>...
+#include "web/http/tls/in/Client.h"                          // for Client, Client<>...
+#include "web/websocket/client/SubProtocolFactorySelector.h" // for SubProtocolFactorySelector
 
 #include <cstddef>
 #include <openssl/ssl.h> // IWYU pragma: keep
@@ -37,10 +43,51 @@
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
+// Instantiates 'start' for the client class of the transport selected by the options
+template <typename Start>
+static void withTransport(const echoclient::Options& options, const Start& start) {
+    if (!options.unixPath.empty()) {
+        start.template operator()<web::http::legacy::un::Client>();
+    } else if (options.tls) {
+        start.template operator()<web::http::tls::in::Client>();
+    } else {
+        start.template operator()<web::http::legacy::in::Client>();
+    }
+}
+
 int main(int argc, char* argv[]) {
+    echoclient::Options options = echoclient::Options::parse(argc, argv);
+    options.exportToSubProtocol();
+
+    // Linked in so that the load report can read the subprotocol's statistics
+    web::websocket::client::SubProtocolFactorySelector::link("echo", echoClientSubProtocolFactory);
+
     core::SNodeC::init(argc, argv);
 
-    {
+    if (!options.replay.empty()) {
+        withTransport(options, [&options]<typename Client>() -> void {
+            echoclient::startReplay<Client>(options);
+        });
+    } else if (!options.scenario.empty()) {
+        echoclient::ScenarioScript script = echoclient::findScenario(options.scenario);
+
+        if (script == nullptr) {
+            LOG(ERROR) << "Unknown scenario: " << options.scenario;
+            return 1;
+        }
+
+        withTransport(options, [&options, script]<typename Client>() -> void {
+            echoclient::startScenario<Client>(options, script);
+        });
+    } else if (options.connections > 0 && options.storm) {
+        withTransport(options, [&options]<typename Client>() -> void {
+            echoclient::startStorm<Client>(options);
+        });
+    } else if (options.connections > 0) {
+        withTransport(options, [&options]<typename Client>() -> void {
+            echoclient::startLoad<Client>(options);
+        });
+    } else {
         using EchoClientLegacy = web::http::legacy::in::Client;
         using SocketConnectionLegacy = EchoClientLegacy::SocketConnection;
         using Request = EchoClientLegacy::Request;
@@ -142,6 +189,12 @@ int main(int argc, char* argv[]) {
             },
             [](const SocketConnectionTLS* socketConnection) -> void {
                 VLOG(0) << "OnConnected";
+
+                if (SSL_session_reused(socketConnection->getSSL()) != 0) { // Certificate checked when the session was established
+                    VLOG(0) << "     Session resumed";
+                    return;
+                }
+
                 X509* server_cert = SSL_get_peer_certificate(socketConnection->getSSL());
                 if (server_cert != nullptr) {
                     long verifyErr = SSL_get_verify_result(socketConnection->getSSL());
@@ -16,65 +16,117 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "server/AssetCache.h"
+#include "server/Options.h"
+#include "server/ShardGroup.h"
+#include "server/TlsSessions.h"
+#include "server/Upgrade.h"
+#include "subprotocol/server/echo/Config.h"
+#include "subprotocol/server/echo/EchoFactory.h"
+#include "subprotocol/server/echo/Metrics.h"
+#include "subprotocol/server/echo/Relay.h"
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include "core/timer/Timer.h"
 #include "express/legacy/in/WebApp.h"
+#include "express/legacy/un/WebApp.h"
 #include "express/tls/in/WebApp.h"
 #include "log/Logger.h"
+#include "web/websocket/server/SubProtocolFactorySelector.h"
 
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <openssl/ssl.h>
 #include <string>
+#include <unistd.h>
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 using namespace express;
 
+using web::websocket::subprotocol::echo::server::Config;
+using web::websocket::subprotocol::echo::server::Metrics;
+using web::websocket::subprotocol::echo::server::Relay;
+
 int main(int argc, char* argv[]) {
+    // Linked in so that /metrics can read the subprotocol's counters
+    web::websocket::server::SubProtocolFactorySelector::link("echo", echoServerSubProtocolFactory);
+    web::websocket::server::SubProtocolFactorySelector::link("pubsub", pubsubServerSubProtocolFactory);
+
+    echoserver::Options options = echoserver::Options::parse(argc, argv);
+
+    // Before forking: all workers derive the same session ticket keys
+    echoserver::TlsSessions::init(options.tlsTicketRotation);
+
+    // Fork before SNodeC is initialized: every worker runs its own event loop on its own SO_REUSEPORT listeners
+    std::unique_ptr<echoserver::ShardGroup> shardGroup;
+    std::size_t worker = 0;
+    if (options.workers > 1) {
+        shardGroup = std::make_unique<echoserver::ShardGroup>(options.workers, options.shardRing);
+        worker = shardGroup->fork();
+        Relay::install(shardGroup.get());
+    }
+
     express::WebApp::init(argc, argv);
 
-    legacy::in::WebApp legacyApp("legacy");
+    if (shardGroup) {
+        core::timer::Timer::intervalTimer(
+            [&shardGroup]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                shardGroup->drain();
+            },
+            options.shardPoll);
+
+        core::timer::Timer::intervalTimer(
+            [&shardGroup]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                shardGroup->shareMetrics();
+            },
+            echoserver::ShardGroup::METRICS_INTERVAL);
+    }
 
-    legacyApp.get("/", [] APPLICATION(req, res) {
+    // With several workers a scrape covers all of them, whichever worker accepted the connection
+    const auto sendMetrics =
+        [&shardGroup]([[maybe_unused]] const std::shared_ptr<Request>& req, const std::shared_ptr<Response>& res) -> void {
+            res->set("Content-Type", "text/plain; version=0.0.4");
+            res->send(shardGroup ? Metrics::render(shardGroup->metrics()) : Metrics::instance().render());
+        };
+
+    const Config echoConfig = Config::fromEnvironment();
+    const echoserver::Upgrade upgrade;
+
+    echoserver::AssetCache assetCache(CMAKE_CURRENT_SOURCE_DIR "/html");
+    if (options.assetReload > 0) {
+        core::timer::Timer::intervalTimer(
+            [&assetCache]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                assetCache.refresh();
+            },
+            options.assetReload);
+    }
+
+    const auto serveAsset = [&assetCache] APPLICATION(req, res) {
         if (req->url == "/" || req->url == "/index.html") {
             req->url = "/wstest.html";
         }
 
-        VLOG(0) << CMAKE_CURRENT_SOURCE_DIR "/html" + req->url;
-        res->sendFile(CMAKE_CURRENT_SOURCE_DIR "/html" + req->url, [&req](int ret) -> void {
-            if (ret != 0) {
-                PLOG(ERROR) << req->url;
-            }
-        });
-    });
-
-    legacyApp.get("/ws", [](std::shared_ptr<Request> req, std::shared_ptr<Response> res) -> void {
-        std::string uri = req->originalUrl;
-
-        VLOG(1) << "OriginalUri: " << uri;
-        VLOG(1) << "Uri: " << req->url;
-
-        VLOG(1) << "Host: " << req->get("host");
-        VLOG(1) << "Connection: " << req->get("connection");
-        VLOG(1) << "Origin: " << req->get("origin");
-        VLOG(1) << "Sec-WebSocket-Protocol: " << req->get("sec-websocket-protocol");
-        VLOG(1) << "sec-web-socket-extensions: " << req->get("sec-websocket-extensions");
-        VLOG(1) << "sec-websocket-key: " << req->get("sec-websocket-key");
-        VLOG(1) << "sec-websocket-version: " << req->get("sec-websocket-version");
-        VLOG(1) << "upgrade: " << req->get("upgrade");
-        VLOG(1) << "user-agent: " << req->get("user-agent");
-
-        if (web::http::ciContains(req->get("connection"), "Upgrade")) {
-            res->upgrade(req, [&subProtocolsRequested = req->get("upgrade"), res](const std::string& name) -> void {
-                if (!name.empty()) {
-                    VLOG(1) << "Successful upgrade to '" << name << "'  requested: " << subProtocolsRequested;
-                } else {
-                    VLOG(1) << "Can not upgrade to any of '" << subProtocolsRequested << "'";
+        if (!assetCache.serve(req, res)) {
+            VLOG(0) << CMAKE_CURRENT_SOURCE_DIR "/html" + req->url;
+            res->sendFile(CMAKE_CURRENT_SOURCE_DIR "/html" + req->url, [&req](int ret) -> void {
+                if (ret != 0) {
+                    PLOG(ERROR) << req->url;
                 }
-                res->end();
             });
-        } else {
-            res->sendStatus(404);
         }
-    });
+    };
+
+    legacy::in::WebApp legacyApp("legacy");
+    legacyApp.getConfig().setReusePort(options.workers > 1);
+
+    legacyApp.get("/metrics", sendMetrics);
+
+    legacyApp.get("/", serveAsset);
+
+    legacyApp.get("/ws", upgrade);
 
     legacyApp.listen([](const legacy::in::WebApp::SocketAddress& socketAddress,
                         const core::socket::State& state) -> void { // Listen on all bluetooth interfaces on channel 16{
@@ -94,52 +146,62 @@ int main(int argc, char* argv[]) {
         }
     });
 
+    // Same routes without the TCP stack: co-located sidecars and transport overhead benchmarks
+    if (!options.unixPath.empty()) {
+        std::string unixPath = options.workers > 1 ? options.unixPath + "." + std::to_string(worker) : options.unixPath;
+        unlink(unixPath.c_str()); // Left over by a previous run
+
+        legacy::un::WebApp unixApp("unix");
+
+        unixApp.get("/metrics", sendMetrics);
+
+        unixApp.get("/", serveAsset);
+
+        unixApp.get("/ws", upgrade);
+
+        unixApp.listen(unixPath, [](const legacy::un::WebApp::SocketAddress& socketAddress, const core::socket::State& state) -> void {
+            switch (state) {
+                case core::socket::State::OK:
+                    VLOG(1) << "unix: listening on '" << socketAddress.toString() << "'";
+                    break;
+                case core::socket::State::DISABLED:
+                    VLOG(1) << "unix: disabled";
+                    break;
+                case core::socket::State::ERROR:
+                    VLOG(1) << "unix: non critical error occurred";
+                    break;
+                case core::socket::State::FATAL:
+                    VLOG(1) << "unix: critical error occurred";
+                    break;
+            }
+        });
+    }
+
     {
         tls::in::WebApp tlsApp("tls");
+        tlsApp.getConfig().setReusePort(options.workers > 1);
 
-        tlsApp.get("/", [] APPLICATION(req, res) {
-            if (req->url == "/" || req->url == "/index.html") {
-                req->url = "/wstest.html";
-            }
+        tlsApp.setOnConnect([&echoConfig](tls::in::WebApp::SocketConnection* socketConnection) -> void {
+            echoserver::TlsSessions::attach(socketConnection->getSSL());
 
-            VLOG(0) << CMAKE_CURRENT_SOURCE_DIR "/html" + req->url;
-            res->sendFile(CMAKE_CURRENT_SOURCE_DIR "/html" + req->url, [&req](int ret) -> void {
-                if (ret != 0) {
-                    PLOG(ERROR) << req->url;
-                }
-            });
+            if (echoConfig.idleCompact > 0) { // OpenSSL then frees the record buffers of a connection whenever they are drained
+                SSL_set_mode(socketConnection->getSSL(), SSL_MODE_RELEASE_BUFFERS);
+            }
         });
 
-        tlsApp.get("/ws", [](std::shared_ptr<Request> req, std::shared_ptr<Response> res) -> void {
-            std::string uri = req->originalUrl;
-
-            VLOG(1) << "OriginalUri: " << uri;
-            VLOG(1) << "Uri: " << req->url;
-
-            VLOG(1) << "Connection: " << req->get("connection");
-            VLOG(1) << "Host: " << req->get("host");
-            VLOG(1) << "Origin: " << req->get("origin");
-            VLOG(1) << "Sec-WebSocket-Protocol: " << req->get("sec-websocket-protocol");
-            VLOG(1) << "sec-web-socket-extensions: " << req->get("sec-websocket-extensions");
-            VLOG(1) << "sec-websocket-key: " << req->get("sec-websocket-key");
-            VLOG(1) << "sec-websocket-version: " << req->get("sec-websocket-version");
-            VLOG(1) << "upgrade: " << req->get("upgrade");
-            VLOG(1) << "user-agent: " << req->get("user-agent");
-
-            if (web::http::ciContains(req->get("connection"), "Upgrade")) {
-                res->upgrade(req, [&subProtocolsRequested = req->get("upgrade"), res](const std::string& name) -> void {
-                    if (!name.empty()) {
-                        VLOG(1) << "Successful upgrade to '" << name << "'  requested: " << subProtocolsRequested;
-                    } else {
-                        VLOG(1) << "Can not upgrade to any of '" << subProtocolsRequested << "'";
-                    }
-                    res->end();
-                });
-            } else {
-                res->sendStatus(404);
+        tlsApp.setOnConnected([](tls::in::WebApp::SocketConnection* socketConnection) -> void {
+            Metrics::instance().tlsHandshakes++;
+            if (SSL_session_reused(socketConnection->getSSL()) != 0) {
+                Metrics::instance().tlsResumptions++;
             }
         });
 
+        tlsApp.get("/metrics", sendMetrics);
+
+        tlsApp.get("/", serveAsset);
+
+        tlsApp.get("/ws", upgrade);
+
         tlsApp.listen([](const legacy::in::WebApp::SocketAddress& socketAddress,
                          const core::socket::State& state) -> void { // Listen on all bluetooth interfaces on channel 16{
             switch (state) {
@@ -0,0 +1,276 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AssetCache.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "express/Request.h"
+#include "express/Response.h"
+#include "log/Logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <zlib.h>
+
+#ifdef ECHO_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    static std::string contentType(const std::filesystem::path& file) {
+        static const std::map<std::string, std::string> contentTypes{{".html", "text/html; charset=utf-8"},
+                                                                     {".js", "text/javascript; charset=utf-8"},
+                                                                     {".css", "text/css; charset=utf-8"},
+                                                                     {".json", "application/json"},
+                                                                     {".svg", "image/svg+xml"},
+                                                                     {".png", "image/png"},
+                                                                     {".ico", "image/x-icon"}};
+
+        std::map<std::string, std::string>::const_iterator it = contentTypes.find(file.extension().string());
+
+        return it != contentTypes.end() ? it->second : "application/octet-stream";
+    }
+
+    static std::string etag(const std::string& data, const char* suffix) {
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a
+        for (unsigned char c : data) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+
+        char tag[40];
+        std::snprintf(tag, sizeof(tag), "\"%016llx%s\"", static_cast<unsigned long long>(hash), suffix);
+
+        return tag;
+    }
+
+    static bool gzip(const std::string& data, std::string& compressed) {
+        z_stream stream{};
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+
+        compressed.resize(deflateBound(&stream, data.size()));
+
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_out = static_cast<uInt>(compressed.size());
+
+        bool success = ::deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        compressed.resize(compressed.size() - stream.avail_out);
+
+        deflateEnd(&stream);
+
+        return success && compressed.size() < data.size();
+    }
+
+    static bool brotli([[maybe_unused]] const std::string& data, [[maybe_unused]] std::string& compressed) {
+#ifdef ECHO_HAS_BROTLI
+        std::size_t compressedSize = BrotliEncoderMaxCompressedSize(data.size());
+        compressed.resize(compressedSize);
+
+        bool success = BrotliEncoderCompress(BROTLI_MAX_QUALITY,
+                                             BROTLI_DEFAULT_WINDOW,
+                                             BROTLI_MODE_TEXT,
+                                             data.size(),
+                                             reinterpret_cast<const uint8_t*>(data.data()),
+                                             &compressedSize,
+                                             reinterpret_cast<uint8_t*>(compressed.data())) == BROTLI_TRUE;
+        compressed.resize(compressedSize);
+
+        return success && compressed.size() < data.size();
+#else
+        return false;
+#endif
+    }
+
+    // Weak comparison as required for If-None-Match (RFC 7232 3.2): a W/ prefix does not matter
+    static bool matches(const std::string& ifNoneMatch, const std::string& etag) {
+        return ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos;
+    }
+
+    static std::string trim(const std::string& string) {
+        std::size_t begin = string.find_first_not_of(" \t");
+        std::size_t end = string.find_last_not_of(" \t");
+
+        return begin != std::string::npos ? string.substr(begin, end - begin + 1) : std::string();
+    }
+
+    static std::string lower(std::string string) {
+        std::transform(string.begin(), string.end(), string.begin(), [](unsigned char c) -> char {
+            return static_cast<char>(std::tolower(c));
+        });
+
+        return string;
+    }
+
+    // Accept-Encoding (RFC 7231 5.3.4): a coding is acceptable if it is listed, or covered by "*" if not listed, with a
+    // qvalue other than 0
+    static bool accepts(const std::string& acceptEncoding, const std::string& coding) {
+        std::istringstream entryStream(acceptEncoding);
+        std::string entry;
+        bool wildcard = false;
+
+        while (std::getline(entryStream, entry, ',')) {
+            std::istringstream parameterStream(entry);
+            std::string token;
+            std::string parameter;
+
+            std::getline(parameterStream, token, ';');
+            token = lower(trim(token));
+
+            double q = 1;
+            while (std::getline(parameterStream, parameter, ';')) {
+                std::size_t equal = parameter.find('=');
+
+                if (equal != std::string::npos && lower(trim(parameter.substr(0, equal))) == "q") {
+                    std::string value = trim(parameter.substr(equal + 1));
+                    char* end = nullptr;
+                    double parsed = std::strtod(value.c_str(), &end);
+
+                    if (!value.empty() && *end == '\0') { // A malformed qvalue is ignored
+                        q = parsed;
+                    }
+                }
+            }
+
+            if (token == coding) {
+                return q != 0;
+            } else if (token == "*") {
+                wildcard = q != 0;
+            }
+        }
+
+        return wildcard;
+    }
+
+    AssetCache::AssetCache(const std::filesystem::path& root)
+        : root(root) {
+        refresh();
+    }
+
+    void AssetCache::load(const std::filesystem::path& file) {
+        std::ifstream stream(file, std::ios::binary);
+        if (!stream) {
+            PLOG(ERROR) << "AssetCache: " << file.string();
+            return;
+        }
+
+        Asset asset;
+        asset.contentType = contentType(file);
+        asset.modified = std::filesystem::last_write_time(file);
+        asset.identity.data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        asset.identity.etag = etag(asset.identity.data, "");
+
+        if (gzip(asset.identity.data, asset.gzip.data)) {
+            asset.gzip.etag = etag(asset.identity.data, "-gz");
+        } else {
+            asset.gzip.data.clear();
+        }
+
+        if (brotli(asset.identity.data, asset.brotli.data)) {
+            asset.brotli.etag = etag(asset.identity.data, "-br");
+        } else {
+            asset.brotli.data.clear();
+        }
+
+        VLOG(1) << "AssetCache: " << file.string() << " (" << asset.identity.data.size() << " bytes, gzip " << asset.gzip.data.size()
+                << ", br " << asset.brotli.data.size() << ")";
+
+        assets["/" + std::filesystem::relative(file, root).generic_string()] = std::move(asset);
+    }
+
+    void AssetCache::refresh() {
+        std::error_code ec;
+        std::set<std::string> seen;
+
+        for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(root, ec)) {
+            if (entry.is_regular_file()) {
+                std::string url = "/" + std::filesystem::relative(entry.path(), root).generic_string();
+                std::map<std::string, Asset>::const_iterator it = assets.find(url);
+
+                if (it == assets.end() || it->second.modified != entry.last_write_time()) {
+                    load(entry.path());
+                }
+
+                seen.insert(url);
+            }
+        }
+
+        if (ec) {
+            LOG(ERROR) << "AssetCache: " << root.string() << ": " << ec.message();
+        } else { // An incomplete walk does not tell which files are gone
+            std::erase_if(assets, [&seen](const std::pair<const std::string, Asset>& asset) -> bool {
+                bool removed = !seen.contains(asset.first);
+                if (removed) {
+                    VLOG(1) << "AssetCache: " << asset.first << " removed";
+                }
+                return removed;
+            });
+        }
+    }
+
+    bool AssetCache::serve(const std::shared_ptr<express::Request>& req, const std::shared_ptr<express::Response>& res) const {
+        std::map<std::string, Asset>::const_iterator it = assets.find(req->url);
+        if (it == assets.end()) {
+            return false;
+        }
+
+        const Asset& asset = it->second;
+        const std::string& acceptEncoding = req->get("accept-encoding");
+
+        const Variant* variant = &asset.identity;
+        const char* contentEncoding = nullptr;
+
+        if (!asset.brotli.data.empty() && accepts(acceptEncoding, "br")) {
+            variant = &asset.brotli;
+            contentEncoding = "br";
+        } else if (!asset.gzip.data.empty() && accepts(acceptEncoding, "gzip")) {
+            variant = &asset.gzip;
+            contentEncoding = "gzip";
+        }
+
+        res->set("ETag", variant->etag);
+        res->set("Vary", "Accept-Encoding");
+        res->set("Cache-Control", "no-cache");
+
+        if (matches(req->get("if-none-match"), variant->etag)) {
+            res->status(304).end();
+        } else {
+            res->set("Content-Type", asset.contentType);
+            if (contentEncoding != nullptr) {
+                res->set("Content-Encoding", contentEncoding);
+            }
+            res->send(variant->data.data(), variant->data.size());
+        }
+
+        return true;
+    }
+
+} // namespace echoserver
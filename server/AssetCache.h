@@ -0,0 +1,77 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOSERVER_ASSETCACHE_H
+#define ECHOSERVER_ASSETCACHE_H
+
+namespace express {
+    class Request;
+    class Response;
+} // namespace express
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <filesystem> // for path, file_time_type
+#include <map>        // for map
+#include <memory>     // for shared_ptr
+#include <string>     // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    /*
+     * In-memory copy of a static asset directory. Every file is loaded once together with its gzip and (if
+     * available) brotli variant, so a page load costs neither disk access nor compression. Each variant carries its
+     * own strong ETag; If-None-Match is answered with 304.
+     */
+    class AssetCache {
+    public:
+        explicit AssetCache(const std::filesystem::path& root);
+
+        // Serves req->url from the cache. Returns false if the asset is not cached.
+        bool serve(const std::shared_ptr<express::Request>& req, const std::shared_ptr<express::Response>& res) const;
+
+        // Reloads all assets modified since they have been loaded, picks up new files and drops deleted ones
+        void refresh();
+
+    private:
+        struct Variant {
+            std::string data;
+            std::string etag;
+        };
+
+        struct Asset {
+            std::string contentType;
+            std::filesystem::file_time_type modified;
+
+            Variant identity;
+            Variant gzip;
+            Variant brotli;
+        };
+
+        void load(const std::filesystem::path& file);
+
+        const std::filesystem::path root;
+
+        std::map<std::string, Asset> assets; // Keyed by url, e.g. "/wstest.html"
+    };
+
+} // namespace echoserver
+
+#endif // ECHOSERVER_ASSETCACHE_H
@@ -0,0 +1,62 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Options.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    Options Options::parse(int& argc, char* argv[]) {
+        Options options;
+
+        int kept = 1;
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg(argv[i]);
+            std::string value(arg.substr(arg.find('=') != std::string_view::npos ? arg.find('=') + 1 : arg.size()));
+
+            if (arg.starts_with("--asset-reload=")) {
+                options.assetReload = std::strtod(value.c_str(), nullptr);
+            } else if (arg.starts_with("--workers=")) {
+                options.workers = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+            } else if (arg.starts_with("--shard-ring=")) {
+                options.shardRing = std::max<std::size_t>(4096, std::strtoul(value.c_str(), nullptr, 10));
+            } else if (arg.starts_with("--shard-poll=")) {
+                options.shardPoll = std::strtod(value.c_str(), nullptr);
+            } else if (arg.starts_with("--tls-ticket-rotation=")) {
+                options.tlsTicketRotation = std::max(0.0, std::strtod(value.c_str(), nullptr));
+            } else if (arg.starts_with("--unix=")) {
+                options.unixPath = value;
+            } else {
+                argv[kept++] = argv[i];
+            }
+        }
+        argv[kept] = nullptr;
+        argc = kept;
+
+        return options;
+    }
+
+} // namespace echoserver
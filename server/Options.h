@@ -0,0 +1,57 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOSERVER_OPTIONS_H
+#define ECHOSERVER_OPTIONS_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <string>  // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    /*
+     * Options of wsechoserver. They are consumed from the command line before it is handed over to SNodeC, all
+     * remaining arguments are left untouched.
+     *
+     *   --asset-reload=S       check the cached html assets for modifications every S seconds (0: never)
+     *   --workers=N            fork N worker processes sharing the listening ports via SO_REUSEPORT (default: 1)
+     *   --shard-ring=BYTES     capacity of each inter-worker broadcast ring (default: 4 MiB); larger messages are
+     *                          relayed in chunks
+     *   --shard-poll=S         interval in seconds at which a worker drains broadcasts of the others (default: 0.001)
+     *   --tls-ticket-rotation=S  lifetime of a TLS session ticket key in seconds (default: 3600, 0: no session tickets)
+     *   --unix=PATH            also serve on the AF_UNIX stream socket PATH; with several workers each one listens on
+     *                          PATH.<worker> as unix sockets can not be shared via SO_REUSEPORT
+     */
+    struct Options {
+        double assetReload = 0;
+        std::size_t workers = 1;
+        std::size_t shardRing = 4 * 1024 * 1024;
+        double shardPoll = 0.001;
+        double tlsTicketRotation = 3600;
+        std::string unixPath;
+
+        static Options parse(int& argc, char* argv[]);
+    };
+
+} // namespace echoserver
+
+#endif // ECHOSERVER_OPTIONS_H
@@ -0,0 +1,312 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShardGroup.h"
+
+#include "subprotocol/server/echo/Echo.h"
+#include "subprotocol/server/echo/Frame.h"
+#include "subprotocol/server/echo/Metrics.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "log/Logger.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    using web::websocket::subprotocol::echo::server::Echo;
+    using web::websocket::subprotocol::echo::server::Frame;
+    using web::websocket::subprotocol::echo::server::Metrics;
+
+    /*
+     * Records are [uint32_t payload length][uint8_t opcode][uint8_t flags][2 bytes padding][payload], padded to 8
+     * bytes. A message is split into several records, all but the last one flagged MORE. The positions are free
+     * running; the byte offset is the position modulo the capacity, records may wrap.
+     */
+    struct ShardGroup::Ring {
+        static constexpr uint8_t MORE = 0x01;
+
+        alignas(64) std::atomic<uint64_t> head{0}; // Written by the consumer only
+        alignas(64) std::atomic<uint64_t> tail{0}; // Written by the producer only
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be usable across processes");
+
+        char* buffer() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+
+        void copyIn(std::size_t capacity, uint64_t position, const char* data, std::size_t length) {
+            std::size_t offset = position % capacity;
+            std::size_t first = std::min(length, capacity - offset);
+
+            std::memcpy(buffer() + offset, data, first);
+            std::memcpy(buffer(), data + first, length - first);
+        }
+
+        void copyOut(std::size_t capacity, uint64_t position, char* data, std::size_t length) {
+            std::size_t offset = position % capacity;
+            std::size_t first = std::min(length, capacity - offset);
+
+            std::memcpy(data, buffer() + offset, first);
+            std::memcpy(data + first, buffer(), length - first);
+        }
+
+        bool push(std::size_t capacity, uint8_t opCode, bool more, const char* payload, std::size_t payloadLength) {
+            uint64_t position = tail.load(std::memory_order_relaxed);
+            std::size_t recordLength = (8 + payloadLength + 7) & ~std::size_t{7};
+
+            if (capacity - (position - head.load(std::memory_order_acquire)) < recordLength) {
+                return false;
+            }
+
+            char header[8] = {};
+            uint32_t length = static_cast<uint32_t>(payloadLength);
+            std::memcpy(header, &length, sizeof(length));
+            header[4] = static_cast<char>(opCode);
+            header[5] = static_cast<char>(more ? MORE : 0);
+
+            copyIn(capacity, position, header, sizeof(header));
+            copyIn(capacity, position + sizeof(header), payload, payloadLength);
+
+            tail.store(position + recordLength, std::memory_order_release);
+
+            return true;
+        }
+
+        // Appends the payload to 'payload'
+        bool pop(std::size_t capacity, uint8_t& opCode, bool& more, std::string& payload) {
+            uint64_t position = head.load(std::memory_order_relaxed);
+
+            if (position == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            char header[8];
+            copyOut(capacity, position, header, sizeof(header));
+
+            uint32_t length = 0;
+            std::memcpy(&length, header, sizeof(length));
+            opCode = static_cast<uint8_t>(header[4]);
+            more = (static_cast<uint8_t>(header[5]) & MORE) != 0;
+
+            std::size_t size = payload.size();
+            payload.resize(size + length);
+            copyOut(capacity, position + sizeof(header), payload.data() + size, length);
+
+            head.store(position + ((8 + length + 7) & ~uint64_t{7}), std::memory_order_release);
+
+            return true;
+        }
+    };
+
+    // Counters are copied one by one, a scrape may thus see one field of a refresh before another
+    struct ShardGroup::MetricsBlock {
+        std::array<std::atomic<uint64_t>, Metrics::SNAPSHOT_FIELDS> values{};
+
+        void store(const Metrics::Snapshot& snapshot) {
+            std::array<uint64_t, Metrics::SNAPSHOT_FIELDS> fields;
+            std::memcpy(fields.data(), &snapshot, sizeof(snapshot));
+
+            for (std::size_t field = 0; field < fields.size(); field++) {
+                values[field].store(fields[field], std::memory_order_relaxed);
+            }
+        }
+
+        Metrics::Snapshot load() const {
+            std::array<uint64_t, Metrics::SNAPSHOT_FIELDS> fields;
+
+            for (std::size_t field = 0; field < fields.size(); field++) {
+                fields[field] = values[field].load(std::memory_order_relaxed);
+            }
+
+            Metrics::Snapshot snapshot;
+            std::memcpy(static_cast<void*>(&snapshot), fields.data(), sizeof(snapshot));
+
+            return snapshot;
+        }
+    };
+
+    ShardGroup::ShardGroup(std::size_t workers, std::size_t ringCapacity)
+        : workers(workers)
+        , ringCapacity((ringCapacity + 7) & ~std::size_t{7})
+        , ringSize(sizeof(Ring) + this->ringCapacity)
+        , chunkSize((this->ringCapacity / 4) & ~std::size_t{7})
+        , outbound(workers)
+        , inbound(workers) {
+        memorySize = workers * workers * ringSize + workers * sizeof(MetricsBlock);
+
+        // Shared anonymous mapping: created before fork, thus visible to all workers
+        memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            PLOG(FATAL) << "ShardGroup: mmap";
+        }
+
+        for (std::size_t producer = 0; producer < workers; producer++) {
+            for (std::size_t consumer = 0; consumer < workers; consumer++) {
+                new (ring(producer, consumer)) Ring();
+            }
+        }
+
+        for (std::size_t worker = 0; worker < workers; worker++) {
+            new (metricsBlock(worker)) MetricsBlock();
+        }
+    }
+
+    ShardGroup::~ShardGroup() {
+        munmap(memory, memorySize);
+    }
+
+    ShardGroup::Ring* ShardGroup::ring(std::size_t producer, std::size_t consumer) const {
+        return reinterpret_cast<Ring*>(static_cast<char*>(memory) + (producer * workers + consumer) * ringSize);
+    }
+
+    ShardGroup::MetricsBlock* ShardGroup::metricsBlock(std::size_t worker) const {
+        return reinterpret_cast<MetricsBlock*>(static_cast<char*>(memory) + workers * workers * ringSize) + worker;
+    }
+
+    std::size_t ShardGroup::fork() {
+        pid_t parent = getpid();
+
+        for (std::size_t worker = 1; worker < workers; worker++) {
+            pid_t pid = ::fork();
+
+            if (pid == 0) {
+                prctl(PR_SET_PDEATHSIG, SIGTERM); // Do not outlive worker 0
+                if (getppid() != parent) {
+                    _exit(0);
+                }
+
+                self = worker;
+                break;
+            } else if (pid < 0) {
+                PLOG(ERROR) << "ShardGroup: fork of worker " << worker;
+            }
+        }
+
+        return self;
+    }
+
+    void ShardGroup::publish(const std::shared_ptr<const Frame>& frame) {
+        for (std::size_t consumer = 0; consumer < workers; consumer++) {
+            if (consumer == self) {
+                continue;
+            }
+
+            Outbound& outbound = this->outbound[consumer];
+
+            if (outbound.messages.empty()) {
+                std::size_t offset = 0;
+
+                if (!push(consumer, *frame, offset)) {
+                    outbound.messages.push_back({frame, offset});
+                }
+            } else if (outbound.bytes + frame->payloadSize() <= ringCapacity) {
+                outbound.messages.push_back({frame, 0});
+                outbound.bytes += frame->payloadSize();
+            } else {
+                Metrics::instance().relayDrops++;
+            }
+        }
+    }
+
+    bool ShardGroup::push(std::size_t consumer, const Frame& frame, std::size_t& offset) {
+        Ring* ring = this->ring(self, consumer);
+
+        do {
+            std::size_t length = std::min(frame.payloadSize() - offset, chunkSize);
+            bool more = offset + length < frame.payloadSize();
+
+            if (!ring->push(ringCapacity, frame.getOpCode(), more, frame.payload() + offset, length)) {
+                return false;
+            }
+
+            offset += length;
+        } while (offset < frame.payloadSize());
+
+        return true;
+    }
+
+    void ShardGroup::flush(std::size_t consumer) {
+        Outbound& outbound = this->outbound[consumer];
+
+        while (!outbound.messages.empty() && push(consumer, *outbound.messages.front().frame, outbound.messages.front().offset)) {
+            outbound.messages.pop_front();
+
+            if (!outbound.messages.empty()) {
+                outbound.bytes -= outbound.messages.front().frame->payloadSize();
+            }
+        }
+    }
+
+    void ShardGroup::drain() {
+        for (std::size_t producer = 0; producer < workers; producer++) {
+            if (producer != self) {
+                std::string& message = inbound[producer];
+                uint8_t opCode = 0;
+                bool more = false;
+
+                while (ring(producer, self)->pop(ringCapacity, opCode, more, message)) {
+                    if (!more) {
+                        Echo::broadcastRelayed(opCode, message.data(), message.size());
+
+                        if (message.capacity() > ringCapacity) { // Do not hold on to the memory of an oversized one
+                            std::string().swap(message);
+                        } else {
+                            message.clear();
+                        }
+                    }
+                }
+            }
+        }
+
+        for (std::size_t consumer = 0; consumer < workers; consumer++) {
+            if (consumer != self) {
+                flush(consumer);
+            }
+        }
+    }
+
+    void ShardGroup::shareMetrics() {
+        metricsBlock(self)->store(Metrics::instance().snapshot());
+    }
+
+    Metrics::Snapshot ShardGroup::metrics() {
+        Metrics::Snapshot snapshot = Metrics::instance().snapshot();
+        metricsBlock(self)->store(snapshot);
+
+        for (std::size_t worker = 0; worker < workers; worker++) {
+            if (worker != self) {
+                snapshot += metricsBlock(worker)->load();
+            }
+        }
+
+        return snapshot;
+    }
+
+} // namespace echoserver
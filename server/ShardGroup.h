@@ -0,0 +1,121 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOSERVER_SHARDGROUP_H
+#define ECHOSERVER_SHARDGROUP_H
+
+#include "subprotocol/server/echo/Metrics.h"
+#include "subprotocol/server/echo/Relay.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <cstdint> // for uint8_t
+#include <deque>   // for deque
+#include <memory>  // for shared_ptr
+#include <string>  // for string
+#include <vector>  // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    /*
+     * A group of forked worker processes, each running its own event loop on a SO_REUSEPORT listener.
+     *
+     * Broadcasts cross process boundaries through shared memory: every ordered pair of workers owns a single-producer
+     * single-consumer ring, so publishing never contends and no broker is involved. Each worker drains its inbound
+     * rings periodically and delivers the messages to its local echo connections.
+     *
+     * A message travels in chunks of at most a quarter of the ring, thus messages larger than the ring are relayed as
+     * well. What does not fit into a ring waits, as a reference to the shared frame, until the next drain(). A worker
+     * which falls behind gets at most a ring's worth of messages queued beyond the one in progress; further messages
+     * are not relayed to it and counted as relay drops. Only whole messages are dropped.
+     *
+     * Metrics are shared the same way: each worker owns one block of counters in the mapping which it refreshes
+     * periodically, and whichever worker answers /metrics sums up all blocks.
+     *
+     * Processes rather than threads: SNodeC drives exactly one event loop per process (core::SNodeC and its event loop
+     * are process wide singletons), and the subprotocols keep their connection tables, timer wheel and metrics in
+     * per process statics. Scaling across cores therefore means one process per core, and a broadcast crosses to the
+     * other workers as a copy in their ring rather than as a shared reference.
+     */
+    class ShardGroup : public web::websocket::subprotocol::echo::server::Relay {
+    public:
+        ShardGroup(std::size_t workers, std::size_t ringCapacity);
+        ~ShardGroup() override;
+
+        ShardGroup(const ShardGroup&) = delete;
+        ShardGroup& operator=(const ShardGroup&) = delete;
+
+        // Forks the workers. Returns in every worker (the calling process becomes worker 0) with its index.
+        std::size_t fork();
+
+        void publish(const std::shared_ptr<const web::websocket::subprotocol::echo::server::Frame>& frame) override;
+
+        // Delivers everything the other workers have published since the last call and pushes what is waiting for
+        // room in the rings
+        void drain();
+
+        static constexpr double METRICS_INTERVAL = 1; // Seconds between refreshes of a worker's metrics block
+
+        // Refreshes the metrics block of this worker
+        void shareMetrics();
+
+        // Metrics of all workers, those of the others at most METRICS_INTERVAL old
+        [[nodiscard]] web::websocket::subprotocol::echo::server::Metrics::Snapshot metrics();
+
+    private:
+        struct Ring;
+        struct MetricsBlock;
+
+        // A message partly or not at all pushed to a consumer's ring
+        struct Pending {
+            std::shared_ptr<const web::websocket::subprotocol::echo::server::Frame> frame;
+            std::size_t offset; // Payload bytes pushed already
+        };
+
+        struct Outbound {
+            std::deque<Pending> messages;
+            std::size_t bytes = 0; // Payload bytes of the messages behind the first one
+        };
+
+        Ring* ring(std::size_t producer, std::size_t consumer) const;
+        MetricsBlock* metricsBlock(std::size_t worker) const;
+
+        // Pushes the payload of 'frame' from 'offset' on in chunks; false if the ring ran full before the last one
+        bool push(std::size_t consumer, const web::websocket::subprotocol::echo::server::Frame& frame, std::size_t& offset);
+        void flush(std::size_t consumer);
+
+        std::size_t workers;
+        std::size_t ringCapacity;
+        std::size_t ringSize;
+        std::size_t chunkSize;
+
+        std::size_t self = 0;
+
+        void* memory = nullptr;
+        std::size_t memorySize = 0;
+
+        std::vector<Outbound> outbound;   // Per consumer
+        std::vector<std::string> inbound; // Per producer: the message being reassembled
+    };
+
+} // namespace echoserver
+
+#endif // ECHOSERVER_SHARDGROUP_H
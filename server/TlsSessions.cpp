@@ -0,0 +1,158 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TlsSessions.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+#define SESSION_CACHE_SIZE (64 * 1024)
+
+namespace echoserver {
+
+    std::array<unsigned char, 32> TlsSessions::master{};
+    double TlsSessions::rotation = 0;
+    SSL_CTX* TlsSessions::configured = nullptr;
+
+    static const unsigned char sessionIdContext[] = "wsechoserver";
+
+    void TlsSessions::init(double rotation) {
+        TlsSessions::rotation = rotation;
+
+        RAND_bytes(master.data(), static_cast<int>(master.size()));
+    }
+
+    void TlsSessions::attach(SSL* ssl) {
+        SSL_CTX* ctx = SSL_get_SSL_CTX(ssl);
+
+        if (ctx != configured) {
+            configured = ctx;
+
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(ctx, SESSION_CACHE_SIZE);
+            SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+
+            if (rotation > 0) {
+                SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+                SSL_CTX_set_num_tickets(ctx, 1); // One resumption per connection is all a reconnecting client needs
+                SSL_CTX_set_timeout(ctx, static_cast<long>(std::ceil(2 * rotation)));
+                SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKey);
+            } else {
+                SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            }
+        }
+
+        // An SSL copies these from its SSL_CTX when it is created, which may have been before the SSL_CTX was configured
+        SSL_set_session_id_context(ssl, sessionIdContext, sizeof(sessionIdContext) - 1);
+        if (rotation > 0) {
+            SSL_clear_options(ssl, SSL_OP_NO_TICKET);
+            SSL_set_num_tickets(ssl, 1);
+        } else {
+            SSL_set_options(ssl, SSL_OP_NO_TICKET);
+        }
+    }
+
+    uint64_t TlsSessions::currentPeriod() {
+        double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        return static_cast<uint64_t>(now / rotation);
+    }
+
+    TlsSessions::Keys TlsSessions::derive(uint64_t period) {
+        Keys keys;
+
+        // label || big endian period
+        unsigned char input[1 + sizeof(period)];
+        for (std::size_t i = 0; i < sizeof(period); i++) {
+            input[1 + i] = static_cast<unsigned char>(period >> (8 * (sizeof(period) - 1 - i)));
+        }
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestLength = 0;
+
+        input[0] = 'n';
+        HMAC(EVP_sha256(), master.data(), static_cast<int>(master.size()), input, sizeof(input), digest, &digestLength);
+        std::memcpy(keys.name.data(), input + 1, sizeof(period)); // The period travels in the ticket's key name
+        std::memcpy(keys.name.data() + sizeof(period), digest, keys.name.size() - sizeof(period));
+
+        input[0] = 'a';
+        HMAC(EVP_sha256(), master.data(), static_cast<int>(master.size()), input, sizeof(input), keys.aes.data(), &digestLength);
+
+        input[0] = 'h';
+        HMAC(EVP_sha256(), master.data(), static_cast<int>(master.size()), input, sizeof(input), keys.hmac.data(), &digestLength);
+
+        return keys;
+    }
+
+    int TlsSessions::ticketKey(SSL* ssl,
+                               unsigned char* keyName,
+                               unsigned char* iv,
+                               EVP_CIPHER_CTX* cipher,
+                               EVP_MAC_CTX* mac,
+                               int encrypt) {
+        uint64_t current = currentPeriod();
+        uint64_t period = current;
+
+        if (encrypt == 0) {
+            period = 0;
+            for (std::size_t i = 0; i < sizeof(period); i++) {
+                period = period << 8 | keyName[i];
+            }
+
+            if (period != current && period + 1 != current) {
+                return 0; // Expired or not ours: full handshake
+            }
+        }
+
+        Keys keys = derive(period);
+
+        if (encrypt != 0) {
+            std::copy(keys.name.begin(), keys.name.end(), keyName);
+            if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) <= 0 ||
+                EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, keys.aes.data(), iv) == 0) {
+                return -1;
+            }
+        } else if (!std::equal(keys.name.begin(), keys.name.end(), keyName)) {
+            return 0;
+        } else if (EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, keys.aes.data(), iv) == 0) {
+            return -1;
+        }
+
+        char digest[] = "SHA256";
+        OSSL_PARAM params[] = {OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, keys.hmac.data(), keys.hmac.size()),
+                               OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+                               OSSL_PARAM_construct_end()};
+        if (EVP_MAC_CTX_set_params(mac, params) == 0) {
+            return -1;
+        }
+
+        // 2: valid, but issue a fresh ticket. TLS 1.3 clients use a ticket only once, so they always get a new one.
+        return period == current && SSL_version(ssl) < TLS1_3_VERSION ? 1 : 2;
+    }
+
+} // namespace echoserver
@@ -0,0 +1,67 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOSERVER_TLSSESSIONS_H
+#define ECHOSERVER_TLSSESSIONS_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <array>       // for array
+#include <cstdint>     // for uint64_t
+#include <openssl/ssl.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    /*
+     * TLS session resumption of the tls app: a server side session cache for clients without ticket support and
+     * stateless session tickets (RFC 5077, TLS 1.3 PSK).
+     *
+     * Ticket keys are derived from a random master secret and the current rotation period, so all workers forked after
+     * init() agree on them without any coordination and a client resumes on whichever worker SO_REUSEPORT hands it to.
+     * Tickets of the previous period are still accepted but renewed, older ones fall back to a full handshake.
+     */
+    class TlsSessions {
+    public:
+        // Must be called before the workers are forked. rotation: ticket key lifetime in seconds, 0 disables tickets.
+        static void init(double rotation);
+
+        // Configures the SSL_CTX of a new connection before its handshake, once per SSL_CTX
+        static void attach(SSL* ssl);
+
+    private:
+        struct Keys {
+            std::array<unsigned char, 16> name;
+            std::array<unsigned char, 32> aes;
+            std::array<unsigned char, 32> hmac;
+        };
+
+        static Keys derive(uint64_t period);
+        static uint64_t currentPeriod();
+
+        static int ticketKey(SSL* ssl, unsigned char* keyName, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt);
+
+        static std::array<unsigned char, 32> master;
+        static double rotation;
+        static SSL_CTX* configured;
+    };
+
+} // namespace echoserver
+
+#endif // ECHOSERVER_TLSSESSIONS_H
@@ -0,0 +1,64 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Upgrade.h"
+
+#include "subprotocol/server/echo/Metrics.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include "express/Request.h"
+#include "express/Response.h"
+#include "log/Logger.h"
+#include "web/http/http_utils.h"
+
+#include <string>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    using web::websocket::subprotocol::echo::server::Metrics;
+
+    void Upgrade::operator()(const std::shared_ptr<express::Request>& req, const std::shared_ptr<express::Response>& res) const {
+        const std::string& connection = req->get("connection");
+        const std::string& upgrade = req->get("upgrade");
+        const std::string& extensions = req->get("sec-websocket-extensions");
+
+        VLOG(2) << "Upgrade " << req->originalUrl << ": connection '" << connection << "', upgrade '" << upgrade << "', protocol '"
+                << req->get("sec-websocket-protocol") << "', extensions '" << extensions << "'";
+
+        if (!web::http::ciContains(connection, "Upgrade")) {
+            Metrics::instance().upgradeFailures++;
+            res->sendStatus(404);
+            return;
+        }
+
+        res->upgrade(req, [&upgrade, res](const std::string& name) -> void {
+            if (!name.empty()) {
+                VLOG(1) << "Successful upgrade to '" << name << "'  requested: " << upgrade;
+                Metrics::instance().upgrades++;
+            } else {
+                VLOG(1) << "Can not upgrade to any of '" << upgrade << "'";
+                Metrics::instance().upgradeFailures++;
+            }
+            res->end();
+        });
+    }
+
+} // namespace echoserver
@@ -0,0 +1,47 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ECHOSERVER_UPGRADE_H
+#define ECHOSERVER_UPGRADE_H
+
+namespace express {
+    class Request;
+    class Response;
+} // namespace express
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <memory> // for shared_ptr
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace echoserver {
+
+    /*
+     * Route handler of /ws, shared by the legacy and the tls app. Upgrades arrive in bursts when clients reconnect after
+     * a failover, so the handler looks up each header it needs once, keeps references instead of copies and logs a
+     * single line at verbosity 2.
+     */
+    class Upgrade {
+    public:
+        void operator()(const std::shared_ptr<express::Request>& req, const std::shared_ptr<express::Response>& res) const;
+    };
+
+} // namespace echoserver
+
+#endif // ECHOSERVER_UPGRADE_H
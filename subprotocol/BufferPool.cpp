@@ -0,0 +1,184 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BufferPool.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo {
+
+    BufferPool::BufferPool() {
+        const char* value = std::getenv("ECHO_BUFFER_POOL_CACHE");
+
+        maxCached = value != nullptr ? std::strtoul(value, nullptr, 10) : 64;
+    }
+
+    BufferPool::~BufferPool() {
+        trim();
+    }
+
+    BufferPool& BufferPool::instance() {
+        // Never destroyed: thread locals of the main thread go before the statics, which may still release buffers
+        thread_local BufferPool* bufferPool = new BufferPool();
+
+        return *bufferPool;
+    }
+
+    std::size_t BufferPool::sizeClass(std::size_t size) {
+        return std::max<std::size_t>(std::bit_width(size - 1), MIN_CLASS_BITS) - MIN_CLASS_BITS;
+    }
+
+    char* BufferPool::acquire(std::size_t size, std::size_t& capacity) {
+        if (size > (std::size_t{1} << MAX_CLASS_BITS)) {
+            capacity = size;
+            misses++;
+
+            return new char[size];
+        }
+
+        std::size_t index = sizeClass(size);
+        capacity = std::size_t{1} << (index + MIN_CLASS_BITS);
+
+        if (cached[index].empty()) {
+            misses++;
+
+            return new char[capacity];
+        }
+
+        hits++;
+
+        char* block = cached[index].back();
+        cached[index].pop_back();
+
+        return block;
+    }
+
+    void BufferPool::release(char* block, std::size_t capacity) {
+        if (capacity > (std::size_t{1} << MAX_CLASS_BITS)) {
+            delete[] block;
+        } else {
+            std::vector<char*>& blocks = cached[sizeClass(capacity)];
+
+            if (blocks.size() < maxCached) {
+                blocks.push_back(block);
+            } else {
+                delete[] block;
+            }
+        }
+    }
+
+    void BufferPool::trim() {
+        for (std::vector<char*>& blocks : cached) {
+            for (char* block : blocks) {
+                delete[] block;
+            }
+            std::vector<char*>().swap(blocks);
+        }
+    }
+
+    std::size_t BufferPool::cachedBytes() const {
+        std::size_t bytes = 0;
+
+        for (std::size_t index = 0; index < cached.size(); index++) {
+            bytes += cached[index].size() << (index + MIN_CLASS_BITS);
+        }
+
+        return bytes;
+    }
+
+    Buffer::~Buffer() {
+        clear();
+    }
+
+    Buffer::Buffer(Buffer&& buffer) noexcept
+        : block(std::exchange(buffer.block, nullptr))
+        , length(std::exchange(buffer.length, 0))
+        , capacity(std::exchange(buffer.capacity, 0)) {
+    }
+
+    Buffer& Buffer::operator=(Buffer&& buffer) noexcept {
+        if (this != &buffer) {
+            clear();
+
+            block = std::exchange(buffer.block, nullptr);
+            length = std::exchange(buffer.length, 0);
+            capacity = std::exchange(buffer.capacity, 0);
+        }
+
+        return *this;
+    }
+
+    void Buffer::append(const char* data, std::size_t length) {
+        if (length > 0) {
+            reserve(this->length + length);
+
+            std::memcpy(block + this->length, data, length);
+            this->length += length;
+        }
+    }
+
+    void Buffer::reserve(std::size_t capacity) {
+        if (capacity > this->capacity) {
+            std::size_t grown = 0;
+            char* larger = BufferPool::instance().acquire(std::max(capacity, this->capacity * 2), grown);
+
+            if (block != nullptr) {
+                std::memcpy(larger, block, length);
+                BufferPool::instance().release(block, this->capacity);
+            }
+
+            block = larger;
+            this->capacity = grown;
+        }
+    }
+
+    void Buffer::clear() {
+        if (block != nullptr) {
+            BufferPool::instance().release(block, capacity);
+
+            block = nullptr;
+            length = 0;
+            capacity = 0;
+        }
+    }
+
+    const char* Buffer::data() const {
+        return block;
+    }
+
+    std::size_t Buffer::size() const {
+        return length;
+    }
+
+    bool Buffer::empty() const {
+        return length == 0;
+    }
+
+    std::string_view Buffer::view() const {
+        return std::string_view(block, length);
+    }
+
+} // namespace web::websocket::subprotocol::echo
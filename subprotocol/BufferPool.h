@@ -0,0 +1,107 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_BUFFERPOOL_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_BUFFERPOOL_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <array>       // for array
+#include <cstddef>     // for std::size_t
+#include <cstdint>     // for uint64_t
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo {
+
+    /*
+     * Per thread cache of message buffers in power-of-two size classes from 256 bytes to 16 MiB. Larger buffers are
+     * allocated and freed directly. At most ECHO_BUFFER_POOL_CACHE (environment, default 64) buffers per class are kept;
+     * once warm, assembling messages does not allocate.
+     *
+     * Each thread has a pool of its own, so it is not synchronized. A Buffer filled by an offload worker and released on
+     * the event loop thread simply returns its block to the event loop's pool.
+     */
+    class BufferPool {
+    public:
+        static BufferPool& instance();
+
+        ~BufferPool();
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        // Returns a block of at least 'size' bytes, its actual size is stored in 'capacity'
+        char* acquire(std::size_t size, std::size_t& capacity);
+        void release(char* block, std::size_t capacity);
+
+        // Frees all cached blocks, e.g. once every connection has gone idle
+        void trim();
+
+        [[nodiscard]] std::size_t cachedBytes() const;
+
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+    private:
+        BufferPool();
+
+        static constexpr std::size_t MIN_CLASS_BITS = 8;
+        static constexpr std::size_t MAX_CLASS_BITS = 24;
+
+        static std::size_t sizeClass(std::size_t size);
+
+        std::array<std::vector<char*>, MAX_CLASS_BITS - MIN_CLASS_BITS + 1> cached;
+        std::size_t maxCached;
+    };
+
+    /*
+     * A growable byte buffer drawing its storage from the BufferPool. An empty Buffer holds no memory: clear() hands the
+     * storage back to the pool.
+     */
+    class Buffer {
+    public:
+        Buffer() = default;
+        ~Buffer();
+
+        Buffer(Buffer&& buffer) noexcept;
+        Buffer& operator=(Buffer&& buffer) noexcept;
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        void append(const char* data, std::size_t length);
+        void reserve(std::size_t capacity);
+        void clear();
+
+        [[nodiscard]] const char* data() const;
+        [[nodiscard]] std::size_t size() const;
+        [[nodiscard]] bool empty() const;
+        [[nodiscard]] std::string_view view() const;
+
+    private:
+        char* block = nullptr;
+        std::size_t length = 0;
+        std::size_t capacity = 0;
+    };
+
+} // namespace web::websocket::subprotocol::echo
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_BUFFERPOOL_H
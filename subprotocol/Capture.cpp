@@ -0,0 +1,245 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Capture.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <log/Logger.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+#define BUFFER_SIZE (1024 * 1024)
+#define FLUSH_INTERVAL 1
+
+namespace web::websocket::subprotocol::echo::capture {
+
+    static uint64_t monotonic() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static constexpr std::size_t padded(std::size_t length) {
+        return (length + 7) & ~std::size_t{7};
+    }
+
+    Writer::Writer(const std::string& path, bool payload, double seconds)
+        : payload(payload)
+        , start(monotonic()) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+        if (fd < 0) {
+            PLOG(ERROR) << "Capture: " << path;
+            return;
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic, FileHeader::MAGIC, sizeof(header.magic));
+        header.version = FileHeader::VERSION;
+        header.flags = payload ? FileHeader::PAYLOAD : 0;
+        header.startRealtime = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+        buffer.reserve(BUFFER_SIZE);
+        buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        flushTimer = core::timer::Timer::intervalTimer(
+            [this]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                flush();
+            },
+            FLUSH_INTERVAL);
+
+        if (seconds > 0) {
+            stopTimer = core::timer::Timer::singleshotTimer(
+                [this]() -> void {
+                    stopTimer.reset();
+                    stop();
+                },
+                seconds);
+        }
+
+        LOG(INFO) << "Capture: recording to " << path << (payload ? "" : " (sizes only)");
+    }
+
+    Writer::~Writer() {
+        // Usually destroyed after the event loop has gone, thus the timers are left alone
+        close();
+    }
+
+    bool Writer::recording() const {
+        return fd >= 0;
+    }
+
+    uint64_t Writer::open() {
+        uint64_t connection = ++connections;
+
+        record(connection, Type::OPEN);
+
+        return connection;
+    }
+
+    void Writer::record(uint64_t connection, Type type, uint8_t opCode, const char* data, std::size_t length) {
+        if (fd < 0) {
+            return;
+        }
+
+        std::size_t stored = payload ? length : 0;
+
+        Record record{};
+        record.time = monotonic() - start;
+        record.connection = connection;
+        record.length = static_cast<uint32_t>(length);
+        record.stored = static_cast<uint32_t>(stored);
+        record.type = type;
+        record.opCode = opCode;
+
+        if (buffer.size() + sizeof(record) + padded(stored) > BUFFER_SIZE) {
+            flush();
+        }
+
+        static constexpr char zeros[8] = {};
+
+        buffer.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        buffer.append(data, stored);
+        buffer.append(zeros, padded(stored) - stored);
+    }
+
+    void Writer::stop() {
+        if (flushTimer.has_value()) {
+            flushTimer->cancel();
+            flushTimer.reset();
+        }
+        if (stopTimer.has_value()) {
+            stopTimer->cancel();
+            stopTimer.reset();
+        }
+
+        close();
+    }
+
+    void Writer::close() {
+        if (fd >= 0) {
+            flush();
+
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+
+            LOG(INFO) << "Capture: stopped";
+        }
+
+        buffer.clear();
+    }
+
+    void Writer::flush() {
+        const char* data = buffer.data();
+        std::size_t remaining = buffer.size();
+
+        while (fd >= 0 && remaining > 0) {
+            ssize_t written = ::write(fd, data, remaining);
+
+            if (written > 0) {
+                data += written;
+                remaining -= static_cast<std::size_t>(written);
+            } else if (errno != EINTR) {
+                PLOG(ERROR) << "Capture: write failed, stopping";
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        buffer.clear();
+        if (fd >= 0) {
+            buffer.reserve(BUFFER_SIZE);
+        }
+    }
+
+    Reader::Reader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            PLOG(ERROR) << "Capture: " << path;
+            return;
+        }
+
+        struct stat status {};
+        if (fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(FileHeader)) {
+            void* mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const char*>(mapping);
+                size = static_cast<std::size_t>(status.st_size);
+
+                madvise(mapping, size, MADV_SEQUENTIAL);
+            }
+        }
+
+        ::close(fd);
+
+        if (data != nullptr && (std::memcmp(header().magic, FileHeader::MAGIC, sizeof(FileHeader::MAGIC)) != 0 ||
+                                header().version != FileHeader::VERSION)) {
+            LOG(ERROR) << "Capture: " << path << " is no capture file of version " << FileHeader::VERSION;
+
+            munmap(const_cast<char*>(data), size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+
+    Reader::~Reader() {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    bool Reader::valid() const {
+        return data != nullptr;
+    }
+
+    const FileHeader& Reader::header() const {
+        return *reinterpret_cast<const FileHeader*>(data);
+    }
+
+    const Record* Reader::next(const char*& payload) {
+        if (data == nullptr || size - offset < sizeof(Record)) {
+            return nullptr;
+        }
+
+        const Record* record = reinterpret_cast<const Record*>(data + offset);
+        if (size - offset - sizeof(Record) < padded(record->stored)) {
+            return nullptr; // Truncated tail
+        }
+
+        payload = data + offset + sizeof(Record);
+        offset += sizeof(Record) + padded(record->stored);
+
+        return record;
+    }
+
+    void Reader::rewind() {
+        offset = sizeof(FileHeader);
+    }
+
+} // namespace web::websocket::subprotocol::echo::capture
@@ -0,0 +1,142 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_CAPTURE_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_CAPTURE_H
+
+#include "subprotocol/BufferPool.h"
+
+#include <core/timer/Timer.h>
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef>  // for std::size_t
+#include <cstdint>  // for uint64_t, uint32_t, uint8_t
+#include <optional> // for optional
+#include <string>   // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::capture {
+
+    /*
+     * Traffic capture format. A file is a FileHeader followed by Records, each directly followed by its stored payload
+     * padded to 8 bytes. Everything is in host byte order and naturally aligned, so a capture can be mmap()ed and
+     * walked in place. Files are only ever appended to: a capture cut short (crash, full disk) just ends with a
+     * truncated record, which readers ignore.
+     *
+     * Fragments are the chunks handed to onMessageData, i.e. the frame boundaries as the websocket layer delivered them.
+     */
+    struct FileHeader {
+        static constexpr char MAGIC[8] = {'W', 'S', 'E', 'C', 'H', 'O', 'C', 'P'};
+        static constexpr uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;         // PAYLOAD if fragment payloads are stored, otherwise only their sizes
+        uint64_t startRealtime; // Wall clock at the start of the capture, ns since the epoch
+        uint64_t reserved;
+
+        static constexpr uint32_t PAYLOAD = 1;
+    };
+
+    enum class Type : uint8_t {
+        OPEN = 1,     // Connection established
+        START = 2,    // Message start, carries the opcode
+        FRAGMENT = 3, // Message data
+        END = 4,      // Message end
+        CLOSE = 5     // Connection gone
+    };
+
+    struct Record {
+        uint64_t time;       // Monotonic clock, ns since the start of the capture
+        uint64_t connection; // Unique within the capture
+        uint32_t length;     // Original size of a FRAGMENT
+        uint32_t stored;     // Payload bytes following this record
+        Type type;
+        uint8_t opCode;
+        uint8_t reserved[6];
+    };
+
+    static_assert(sizeof(FileHeader) == 32 && sizeof(Record) == 32);
+
+    /*
+     * Streams records into a file. Records are collected in memory and written in large chunks, when the buffer is full
+     * and once a second, so capturing costs a memcpy per fragment on the hot path. The capture stops by itself after
+     * 'seconds' (0: runs until destroyed) or if the file can not be written.
+     */
+    class Writer {
+    public:
+        Writer(const std::string& path, bool payload, double seconds);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        [[nodiscard]] bool recording() const;
+
+        // Returns the id of a new connection
+        uint64_t open();
+        void record(uint64_t connection, Type type, uint8_t opCode = 0, const char* data = nullptr, std::size_t length = 0);
+
+        // Writes out what is buffered and closes the file
+        void stop();
+
+    private:
+        void flush();
+        void close();
+
+        int fd = -1;
+        bool payload;
+        uint64_t start;
+        uint64_t connections = 0;
+
+        Buffer buffer;
+
+        std::optional<core::timer::Timer> flushTimer;
+        std::optional<core::timer::Timer> stopTimer;
+    };
+
+    /*
+     * Read-only view of a capture file, mapped into memory. Records are iterated in file order, which is time order.
+     */
+    class Reader {
+    public:
+        explicit Reader(const std::string& path);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // False if the file could not be mapped or is no capture
+        [[nodiscard]] bool valid() const;
+        [[nodiscard]] const FileHeader& header() const;
+
+        // Returns the next record or nullptr at the end. 'payload' points to the stored payload bytes.
+        const Record* next(const char*& payload);
+        void rewind();
+
+    private:
+        const char* data = nullptr;
+        std::size_t size = 0;
+        std::size_t offset = sizeof(FileHeader);
+    };
+
+} // namespace web::websocket::subprotocol::echo::capture
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_CAPTURE_H
@@ -0,0 +1,62 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Heartbeat.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <random>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo {
+
+    static double uniform(double from, double to) {
+        static std::minstd_rand generator(std::random_device{}());
+
+        return std::uniform_real_distribution<double>(from, to)(generator);
+    }
+
+    void Heartbeat::startHeartbeat(double interval, double timeout) {
+        this->interval = interval;
+        this->timeout = timeout;
+
+        if (interval > 0) {
+            TimerWheel::instance().schedule(this, uniform(0, interval));
+        }
+    }
+
+    void Heartbeat::stopHeartbeat() {
+        TimerWheel::instance().cancel(this);
+    }
+
+    void Heartbeat::onExpired() {
+        if (active) {
+            active = false;
+        } else if (flyingPings * interval >= timeout) {
+            onHeartbeatTimeout();
+            return;
+        } else {
+            flyingPings++;
+            onHeartbeatPing();
+        }
+
+        TimerWheel::instance().schedule(this, uniform(0.9 * interval, 1.1 * interval));
+    }
+
+} // namespace web::websocket::subprotocol::echo
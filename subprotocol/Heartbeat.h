@@ -0,0 +1,62 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_HEARTBEAT_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_HEARTBEAT_H
+
+#include "subprotocol/TimerWheel.h"
+
+namespace web::websocket::subprotocol::echo {
+
+    /*
+     * Keepalive of one connection, scheduled on the shared TimerWheel. A connection is only pinged if nothing was
+     * received during the last interval and it is given up once its pings stay unanswered for the timeout. The first
+     * beat is spread uniformly over one interval and every further one is jittered by +-10%, so connections accepted
+     * in a burst do not ping in lockstep.
+     */
+    class Heartbeat : private TimerWheel::Entry {
+    public:
+        // interval == 0 disables the heartbeat
+        void startHeartbeat(double interval, double timeout);
+        void stopHeartbeat();
+
+        // Any inbound frame proves the peer alive
+        void heartbeatActivity() {
+            active = true;
+            flyingPings = 0;
+        }
+
+    protected:
+        Heartbeat() = default;
+        ~Heartbeat() override = default;
+
+        virtual void onHeartbeatPing() = 0;
+        virtual void onHeartbeatTimeout() = 0;
+
+    private:
+        void onExpired() override;
+
+        double interval = 0;
+        double timeout = 0;
+        bool active = false;
+        int flyingPings = 0;
+    };
+
+} // namespace web::websocket::subprotocol::echo
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_HEARTBEAT_H
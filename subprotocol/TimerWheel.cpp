@@ -0,0 +1,150 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimerWheel.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <bit>
+#include <cmath>
+#include <functional>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo {
+
+    TimerWheel::Entry::~Entry() {
+        if (wheel != nullptr) {
+            wheel->cancel(this);
+        }
+    }
+
+    bool TimerWheel::Entry::scheduled() const {
+        return wheel != nullptr;
+    }
+
+    TimerWheel::TimerWheel(double tick, std::size_t slots)
+        : tick(tick)
+        , mask(std::bit_ceil(slots) - 1)
+        , slots(std::bit_ceil(slots), nullptr) {
+    }
+
+    TimerWheel::~TimerWheel() {
+        for (Entry* head : slots) {
+            for (Entry* entry = head; entry != nullptr; entry = entry->next) {
+                entry->wheel = nullptr;
+            }
+        }
+
+        if (timer.has_value()) {
+            timer->cancel();
+        }
+    }
+
+    TimerWheel& TimerWheel::instance() {
+        static TimerWheel timerWheel(0.1, 1024);
+
+        return timerWheel;
+    }
+
+    void TimerWheel::schedule(Entry* entry, double delay) {
+        if (entry->wheel != nullptr) {
+            entry->wheel->unlink(entry);
+        }
+
+        link(entry, std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(delay / tick))));
+
+        if (!timer.has_value()) {
+            timer = core::timer::Timer::intervalTimer(
+                [this]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                    advance();
+                },
+                tick);
+        }
+    }
+
+    void TimerWheel::cancel(Entry* entry) {
+        if (entry->wheel == this) {
+            unlink(entry);
+        }
+    }
+
+    void TimerWheel::advance() {
+        current = (current + 1) & mask;
+
+        Entry* entry = slots[current];
+        while (entry != nullptr) {
+            Entry* next = entry->next;
+
+            if (entry->rounds > 0) {
+                entry->rounds--;
+            } else {
+                unlink(entry);
+                entry->onExpired(); // May reschedule: new entries go to the head and are not visited in this pass
+            }
+
+            entry = next;
+        }
+
+        if (count == 0 && timer.has_value()) {
+            timer->cancel();
+            timer.reset();
+        }
+    }
+
+    std::size_t TimerWheel::size() const {
+        return count;
+    }
+
+    double TimerWheel::getTick() const {
+        return tick;
+    }
+
+    void TimerWheel::link(Entry* entry, std::size_t ticks) {
+        entry->wheel = this;
+        entry->slot = (current + ticks) & mask;
+        entry->rounds = (ticks - 1) / slots.size();
+
+        entry->previous = nullptr;
+        entry->next = slots[entry->slot];
+        if (entry->next != nullptr) {
+            entry->next->previous = entry;
+        }
+        slots[entry->slot] = entry;
+
+        count++;
+    }
+
+    void TimerWheel::unlink(Entry* entry) {
+        if (entry->previous != nullptr) {
+            entry->previous->next = entry->next;
+        } else {
+            slots[entry->slot] = entry->next;
+        }
+        if (entry->next != nullptr) {
+            entry->next->previous = entry->previous;
+        }
+
+        entry->wheel = nullptr;
+        entry->previous = nullptr;
+        entry->next = nullptr;
+
+        count--;
+    }
+
+} // namespace web::websocket::subprotocol::echo
@@ -0,0 +1,99 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_TIMERWHEEL_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_TIMERWHEEL_H
+
+#include <core/timer/Timer.h>
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef>  // for std::size_t
+#include <optional> // for optional
+#include <vector>   // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo {
+
+    /*
+     * Hashed timer wheel (Varghese and Lauck) for the connection heartbeats: instead of one event loop timer per
+     * connection a single interval timer advances the wheel by one slot per tick. Scheduling and cancelling are O(1)
+     * through intrusive lists, a tick only touches the entries of one slot. The driving timer only runs while entries
+     * are scheduled.
+     */
+    class TimerWheel {
+    public:
+        class Entry {
+        public:
+            Entry() = default;
+            virtual ~Entry();
+
+            Entry(const Entry&) = delete;
+            Entry& operator=(const Entry&) = delete;
+
+            [[nodiscard]] bool scheduled() const;
+
+        protected:
+            virtual void onExpired() = 0;
+
+        private:
+            TimerWheel* wheel = nullptr;
+            Entry* previous = nullptr;
+            Entry* next = nullptr;
+            std::size_t slot = 0;
+            std::size_t rounds = 0;
+
+            friend class TimerWheel;
+        };
+
+        TimerWheel(double tick, std::size_t slots);
+        ~TimerWheel();
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        // The wheel of the event loop thread: 100 ms ticks, 1024 slots per rotation
+        static TimerWheel& instance();
+
+        // (Re)schedules 'entry' to expire after 'delay' seconds, rounded up to whole ticks
+        void schedule(Entry* entry, double delay);
+        void cancel(Entry* entry);
+
+        // Advances the wheel by one tick and expires what is due. Normally called by the driving timer.
+        void advance();
+
+        [[nodiscard]] std::size_t size() const;
+        [[nodiscard]] double getTick() const;
+
+    private:
+        void link(Entry* entry, std::size_t ticks);
+        void unlink(Entry* entry);
+
+        double tick;
+        std::size_t mask;
+        std::vector<Entry*> slots;
+        std::size_t current = 0;
+        std::size_t count = 0;
+
+        std::optional<core::timer::Timer> timer;
+    };
+
+} // namespace web::websocket::subprotocol::echo
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_TIMERWHEEL_H
@@ -0,0 +1,75 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_TRACE_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_TRACE_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm> // for max
+#include <cstddef>   // for std::size_t
+#include <cstdlib>   // for getenv, strtoul
+#include <log/Logger.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/*
+ * Hot-path tracing of the echo subprotocols.
+ *
+ *   ECHO_TRACE << ...          logs every event
+ *   ECHO_TRACE_SAMPLED << ...  logs one out of ECHO_TRACE_SAMPLE (environment, default 1000) events per call site
+ *
+ * Both log at verbosity level 2 and are compiled out entirely unless the project is configured with -DECHO_TRACE=ON.
+ * Never stream payload data into a trace, only sizes and opcodes: formatting costs even when sampled.
+ */
+
+namespace web::websocket::subprotocol::echo {
+
+    inline std::size_t traceSampleRate() {
+        static const std::size_t sampleRate = []() -> std::size_t {
+            const char* value = std::getenv("ECHO_TRACE_SAMPLE");
+
+            return value != nullptr ? std::max<std::size_t>(1, std::strtoul(value, nullptr, 10)) : 1000;
+        }();
+
+        return sampleRate;
+    }
+
+} // namespace web::websocket::subprotocol::echo
+
+#ifdef ECHO_TRACE_ENABLED
+
+#define ECHO_TRACE VLOG(2)
+
+#define ECHO_TRACE_SAMPLED                                                                                                                 \
+    if (static std::size_t echoTraceEvents = 0; ++echoTraceEvents < web::websocket::subprotocol::echo::traceSampleRate()) {              \
+    } else if (echoTraceEvents = 0; true)                                                                                                  \
+    VLOG(2)
+
+#else
+
+#define ECHO_TRACE                                                                                                                         \
+    if constexpr (true) {                                                                                                                  \
+    } else                                                                                                                                 \
+        VLOG(2)
+
+#define ECHO_TRACE_SAMPLED ECHO_TRACE
+
+#endif // ECHO_TRACE_ENABLED
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_TRACE_H
@@ -0,0 +1,67 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Config.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    static bool envFlag(const char* name, bool defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::string(value) == "1" || std::string(value) == "true" : defaultValue;
+    }
+
+    static double envDouble(const char* name, double defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::strtod(value, nullptr) : defaultValue;
+    }
+
+    static std::size_t envSize(const char* name, std::size_t defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::strtoul(value, nullptr, 10) : defaultValue;
+    }
+
+    Config Config::fromEnvironment() {
+        Config config;
+
+        config.rate = envDouble("ECHO_RATE", config.rate);
+        config.payloadMin = envSize("ECHO_PAYLOAD_MIN", config.payloadMin);
+        config.payloadMax = envSize("ECHO_PAYLOAD_MAX", config.payloadMax);
+        config.binary = envFlag("ECHO_BINARY", config.binary);
+        config.latency = envFlag("ECHO_LATENCY", config.latency);
+        config.pingInterval = std::max(envDouble("ECHO_PING_INTERVAL", config.pingInterval), 0.0);
+        config.pingTimeout = std::max(envDouble("ECHO_PING_TIMEOUT", config.pingTimeout), config.pingInterval);
+
+        if (config.payloadMax < config.payloadMin) {
+            config.payloadMax = config.payloadMin;
+        }
+
+        return config;
+    }
+
+} // namespace web::websocket::subprotocol::echo::client
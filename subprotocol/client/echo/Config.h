@@ -0,0 +1,59 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_CONFIG_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_CONFIG_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    /*
+     * Runtime settings of the echo client subprotocol, read from the environment once the factory is created.
+     * wsechoclient translates its command line options into these variables before the first upgrade.
+     */
+    struct Config {
+        // ECHO_RATE: messages per second sent by each connection; 0 disables load generation
+        double rate = 0;
+
+        // ECHO_PAYLOAD_MIN, ECHO_PAYLOAD_MAX: payload sizes are drawn uniformly from [payloadMin, payloadMax]
+        std::size_t payloadMin = 64;
+        std::size_t payloadMax = 64;
+
+        // ECHO_BINARY=1: send binary instead of text messages
+        bool binary = false;
+
+        // ECHO_LATENCY=1: stamp messages with sequence number and intended send time and record the RTT of their echoes
+        bool latency = false;
+
+        // ECHO_PING_INTERVAL: seconds without inbound traffic after which the server is pinged; 0 disables heartbeats
+        double pingInterval = 5;
+
+        // ECHO_PING_TIMEOUT: seconds of unanswered pings after which the connection is closed
+        double pingTimeout = 15;
+
+        static Config fromEnvironment();
+    };
+
+} // namespace web::websocket::subprotocol::echo::client
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_CONFIG_H
@@ -18,43 +18,97 @@
 
 #include "Echo.h"
 
+#include "Replay.h"
+#include "Scenario.h"
+#include "Statistics.h"
+#include "subprotocol/Trace.h"
+
 namespace web::websocket {
     class SubProtocolContext;
 }
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
 #include <cstring>
 #include <log/Logger.h>
+#include <random>
+#include <utility>
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
-#define PING_INTERVAL 5
-#define MAX_FLYING_PINGS 3
-
 namespace web::websocket::subprotocol::echo::client {
 
-    Echo::Echo(SubProtocolContext* subProtocolContext, const std::string& name)
-        : web::websocket::client::SubProtocol(subProtocolContext, name, PING_INTERVAL, MAX_FLYING_PINGS) {
+    // Latency stamp: '@' followed by token, sequence number and intended send time (ns), each as 16 hex digits
+    static constexpr std::size_t STAMP_LENGTH = 1 + 3 * 16;
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static std::mt19937_64& generator() {
+        static std::mt19937_64 generator(std::random_device{}());
+
+        return generator;
+    }
+
+    Echo::Echo(SubProtocolContext* subProtocolContext, const std::string& name, const Config& config)
+        : web::websocket::client::SubProtocol(subProtocolContext, name, 0) // Heartbeats run on the shared TimerWheel
+        , config(config)
+        , token(generator()()) {
     }
 
     void Echo::onConnected() {
         VLOG(0) << "Echo connected:";
+
+        startHeartbeat(config.pingInterval, config.pingTimeout);
+
+        Statistics& statistics = Statistics::instance();
+        statistics.connections++;
+
+        auto handshake = statistics.handshaking.find(getSocketConnection());
+        if (handshake != statistics.handshaking.end()) {
+            statistics.lastHandshake = now();
+            statistics.handshakes.record(statistics.lastHandshake - handshake->second);
+            statistics.handshaking.erase(handshake);
+        }
+
+        if (!Replay::instance().bind(this)) {
+            scenario::Connection::bind(this);
+        }
+
+        if (config.rate > 0) {
+            loadStart = now();
+
+            sendTimer = core::timer::Timer::intervalTimer(
+                [this]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                    sendLoadMessages();
+                },
+                1 / config.rate);
+        }
     }
 
     void Echo::onMessageStart(int opCode) {
-        VLOG(0) << "Message Start - OpCode: " << opCode;
+        ECHO_TRACE_SAMPLED << "Message Start - OpCode: " << opCode;
+
+        heartbeatActivity();
+        this->opCode = opCode;
     }
 
     void Echo::onMessageData(const char* junk, std::size_t junkLen) {
-        data += std::string(junk, junkLen);
+        ECHO_TRACE_SAMPLED << "Message Fragment: " << junkLen << " bytes";
 
-        VLOG(0) << "Message Fragment: " << std::string(junk, junkLen);
+        heartbeatActivity();
+        data.append(junk, junkLen);
     }
 
     void Echo::onMessageEnd() {
-        VLOG(0) << "Message Full Data: " << data;
-        VLOG(0) << "Message End";
+        ECHO_TRACE_SAMPLED << "Message End: " << data.size() << " bytes";
         /*
                 forEachClient([&data = this->data](SubProtocol* client) {
                     client->sendMessage(data);
@@ -62,7 +116,26 @@ namespace web::websocket::subprotocol::echo::client {
         */
         // sendMessage(data);
 
-        data.clear();
+        Statistics::instance().messagesReceived++;
+        Statistics::instance().bytesReceived += data.size();
+
+        if (config.latency && data.size() >= STAMP_LENGTH && data.data()[0] == '@') {
+            uint64_t messageToken = 0;
+            uint64_t intendedSendTime = 0;
+
+            std::from_chars(data.data() + 1, data.data() + 17, messageToken, 16);
+            std::from_chars(data.data() + 33, data.data() + 49, intendedSendTime, 16);
+
+            if (messageToken == token) { // The server broadcasts, only our own messages carry a meaningful RTT
+                Statistics::instance().latency.record(now() - intendedSendTime);
+            }
+        }
+
+        if (scenario != nullptr) {
+            scenario->deliver(opCode, std::string(data.view()));
+        }
+
+        data.clear(); // Back to the pool
     }
 
     void Echo::onMessageError(uint16_t errnum) {
@@ -70,12 +143,28 @@ namespace web::websocket::subprotocol::echo::client {
     }
 
     void Echo::onPongReceived() {
-        VLOG(0) << "Pong received";
-        flyingPings = 0;
+        ECHO_TRACE_SAMPLED << "Pong received";
+
+        heartbeatActivity();
     }
 
     void Echo::onDisconnected() {
         VLOG(0) << "Echo disconnected:";
+
+        stopHeartbeat();
+
+        if (sendTimer.has_value()) {
+            sendTimer->cancel();
+            sendTimer.reset();
+        }
+
+        Replay::instance().unbind(this);
+
+        if (scenario != nullptr) {
+            std::exchange(scenario, nullptr)->detach();
+        }
+
+        Statistics::instance().connections--;
     }
 
     bool Echo::onSignal(int sig) {
@@ -84,4 +173,87 @@ namespace web::websocket::subprotocol::echo::client {
         return true;
     }
 
+    void Echo::onHeartbeatPing() {
+        sendPing();
+    }
+
+    void Echo::onHeartbeatTimeout() {
+        VLOG(0) << "Echo: no pong within " << config.pingTimeout << " s, closing";
+
+        getSocketConnection()->close();
+    }
+
+    void Echo::sendLoadMessages() {
+        // Open loop: messages are due at loadStart + n * interval no matter when replies arrive or when the timer
+        // actually fires. Late ticks catch up on all missed messages, each stamped with its intended send time, so
+        // that stalls show up in the latency histogram instead of silently lowering the send rate.
+        uint64_t interval = static_cast<uint64_t>(1e9 / config.rate);
+        uint64_t due = (now() - loadStart) / interval + 1;
+
+        for (; sequence < due; sequence++) {
+            sendLoadMessage(loadStart + sequence * interval);
+        }
+    }
+
+    void Echo::sendLoadMessage(uint64_t intendedSendTime) {
+        static const std::string pattern(std::max(config.payloadMax, STAMP_LENGTH), 'x');
+
+        std::uniform_int_distribution<std::size_t> payloadSize(config.payloadMin, config.payloadMax);
+        std::size_t size = payloadSize(generator());
+
+        if (config.latency) {
+            size = std::max(size, STAMP_LENGTH);
+
+            std::string message(pattern.data(), size);
+            char stamp[STAMP_LENGTH + 1];
+            std::snprintf(stamp, sizeof(stamp), "@%016" PRIx64 "%016" PRIx64 "%016" PRIx64, token, sequence, intendedSendTime);
+            message.replace(0, STAMP_LENGTH, stamp, STAMP_LENGTH);
+
+            if (config.binary) {
+                sendMessage(message.data(), message.size());
+            } else {
+                sendMessage(message);
+            }
+        } else if (config.binary) {
+            sendMessage(pattern.data(), size);
+        } else {
+            sendMessage(pattern.substr(0, size));
+        }
+
+        Statistics::instance().messagesSent++;
+        Statistics::instance().bytesSent += size;
+    }
+
+    void Echo::sendFragment(int opCode, const char* message, std::size_t messageLength, bool first, bool last) {
+        // Same convention as the server: binary messages go out as raw bytes, everything else as text
+        bool binary = opCode == 2;
+
+        if (first && last) {
+            if (binary) {
+                sendMessage(message, messageLength);
+            } else {
+                sendMessage(std::string(message, messageLength));
+            }
+        } else if (first) {
+            if (binary) {
+                sendMessageStart(message, messageLength);
+            } else {
+                sendMessageStart(std::string(message, messageLength));
+            }
+        } else if (last) {
+            sendMessageEnd(message, messageLength);
+        } else {
+            sendMessageFrame(message, messageLength);
+        }
+
+        if (last) {
+            Statistics::instance().messagesSent++;
+        }
+        Statistics::instance().bytesSent += messageLength;
+    }
+
+    void Echo::closeNormally() {
+        sendClose(1000, "Done", 4);
+    }
+
 } // namespace web::websocket::subprotocol::echo::client
@@ -16,33 +16,56 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHO_H
-#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHO_H
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_ECHO_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_ECHO_H
 
+#include "Config.h"
+#include "subprotocol/BufferPool.h"
+#include "subprotocol/Heartbeat.h"
+
+#include <core/timer/Timer.h>
 #include <web/websocket/client/SubProtocol.h>
 
 namespace web::websocket {
     class SubProtocolContext;
 }
 
+namespace web::websocket::subprotocol::echo::client::scenario {
+    class Connection;
+}
+
+namespace echobench {
+    struct Driver;
+}
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
 #include <cstddef> // for std::size_t
-#include <cstdint> // for uint16_t
-#include <string>  // for string, basic_string
+#include <cstdint>  // for uint16_t
+#include <optional> // for optional
+#include <string>   // for string, basic_string
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 namespace web::websocket::subprotocol::echo::client {
 
-    class Echo : public web::websocket::client::SubProtocol {
+    class Echo
+        : public web::websocket::client::SubProtocol
+        , private Heartbeat {
     private:
         using Super = web::websocket::client::SubProtocol;
 
     public:
-        explicit Echo(SubProtocolContext* subProtocolContext, const std::string& name);
+        explicit Echo(SubProtocolContext* subProtocolContext, const std::string& name, const Config& config);
         ~Echo() override = default;
 
+        // Invokes the websocket callbacks without a socket (bench/echobench.cpp)
+        friend struct ::echobench::Driver;
+
+        // Drive this connection instead of the load generator
+        friend class Replay;
+        friend class scenario::Connection;
+
     private:
         void onConnected() override;
         void onMessageStart(int opCode) override;
@@ -53,11 +76,31 @@ namespace web::websocket::subprotocol::echo::client {
         void onDisconnected() override;
         [[nodiscard]] bool onSignal(int sig) override;
 
-        std::string data;
+        void onHeartbeatPing() override;
+        void onHeartbeatTimeout() override;
+
+        void sendLoadMessages();
+        void sendLoadMessage(uint64_t intendedSendTime);
+
+        // Sends one fragment of a message, 'first' and 'last' mark its boundaries
+        void sendFragment(int opCode, const char* message, std::size_t messageLength, bool first, bool last);
+        void closeNormally();
+
+        const Config& config;
+
+        const uint64_t token; // Identifies the messages sent by this connection in the echoed broadcast
+        uint64_t loadStart = 0;
+        uint64_t sequence = 0;
+
+        std::optional<core::timer::Timer> sendTimer;
+
+        Buffer data;
+        int opCode = 0;
 
-        int flyingPings = 0;
+        // Set while a scenario script owns this connection
+        scenario::Connection* scenario = nullptr;
     };
 
 } // namespace web::websocket::subprotocol::echo::client
 
-#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHO_H
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_ECHO_H
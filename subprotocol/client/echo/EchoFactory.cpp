@@ -26,8 +26,13 @@
 
 namespace web::websocket::subprotocol::echo::client {
 
+    EchoFactory::EchoFactory(const std::string& name)
+        : Super(name)
+        , config(Config::fromEnvironment()) {
+    }
+
     Echo* EchoFactory::create(SubProtocolContext* subProtocolContext) {
-        return new Echo(subProtocolContext, getName());
+        return new Echo(subProtocolContext, getName(), config);
     }
 
 } // namespace web::websocket::subprotocol::echo::client
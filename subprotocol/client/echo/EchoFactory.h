@@ -16,25 +16,33 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHOINTERFACE_H
-#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHOINTERFACE_H
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_ECHOINTERFACE_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_ECHOINTERFACE_H
 
+#include "Config.h"
 #include "Echo.h"
 
 #include <web/websocket/SubProtocolFactory.h>
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include <string>
+
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 namespace web::websocket::subprotocol::echo::client {
 
     class EchoFactory : public web::websocket::SubProtocolFactory<Echo> {
+    private:
+        using Super = web::websocket::SubProtocolFactory<Echo>;
+
     public:
-        using web::websocket::SubProtocolFactory<Echo>::SubProtocolFactory;
+        explicit EchoFactory(const std::string& name);
 
     private:
         Echo* create(web::websocket::SubProtocolContext* subProtocolContext) override;
+
+        const Config config;
     };
 
 } // namespace web::websocket::subprotocol::echo::client
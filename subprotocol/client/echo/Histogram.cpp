@@ -0,0 +1,105 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Histogram.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <cmath>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    Histogram::Histogram(uint64_t highestTrackableValue, int significantDigits)
+        : highestTrackableValue(highestTrackableValue) {
+        uint64_t largestValueWithSingleUnitResolution = 2 * static_cast<uint64_t>(std::pow(10, significantDigits));
+
+        subBucketHalfCountMagnitude =
+            static_cast<int>(std::ceil(std::log2(static_cast<double>(largestValueWithSingleUnitResolution)))) - 1;
+        subBucketHalfCount = uint64_t{1} << subBucketHalfCountMagnitude;
+        subBucketMask = (subBucketHalfCount << 1) - 1;
+
+        std::size_t bucketsNeeded = 1;
+        for (uint64_t smallestUntrackableValue = subBucketHalfCount << 1; smallestUntrackableValue <= highestTrackableValue;
+             smallestUntrackableValue <<= 1) {
+            bucketsNeeded++;
+        }
+
+        counts.resize((bucketsNeeded + 1) * subBucketHalfCount);
+    }
+
+    std::size_t Histogram::countsIndex(uint64_t value) const {
+        int bucketIndex = 63 - __builtin_clzll(value | subBucketMask) - subBucketHalfCountMagnitude;
+        uint64_t subBucketIndex = value >> bucketIndex;
+
+        return (static_cast<std::size_t>(bucketIndex + 1) << subBucketHalfCountMagnitude) + (subBucketIndex - subBucketHalfCount);
+    }
+
+    uint64_t Histogram::highestEquivalentValue(std::size_t index) const {
+        int bucketIndex = static_cast<int>(index >> subBucketHalfCountMagnitude) - 1;
+        uint64_t subBucketIndex = (index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+
+        if (bucketIndex < 0) {
+            subBucketIndex -= subBucketHalfCount;
+            bucketIndex = 0;
+        }
+
+        return ((subBucketIndex + 1) << bucketIndex) - 1;
+    }
+
+    void Histogram::record(uint64_t value) {
+        value = std::min(value, highestTrackableValue);
+
+        counts[countsIndex(value)]++;
+        totalCount++;
+        maxValue = std::max(maxValue, value);
+    }
+
+    uint64_t Histogram::percentile(double percentile) const {
+        uint64_t countAtPercentile =
+            std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100 * static_cast<double>(totalCount))));
+
+        uint64_t runningCount = 0;
+        for (std::size_t index = 0; index < counts.size(); index++) {
+            runningCount += counts[index];
+
+            if (runningCount >= countAtPercentile) {
+                return std::min(highestEquivalentValue(index), maxValue);
+            }
+        }
+
+        return maxValue;
+    }
+
+    uint64_t Histogram::max() const {
+        return maxValue;
+    }
+
+    uint64_t Histogram::count() const {
+        return totalCount;
+    }
+
+    void Histogram::reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        totalCount = 0;
+        maxValue = 0;
+    }
+
+} // namespace web::websocket::subprotocol::echo::client
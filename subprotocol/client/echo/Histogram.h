@@ -0,0 +1,65 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_HISTOGRAM_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_HISTOGRAM_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <cstdint> // for uint64_t
+#include <vector>  // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    /*
+     * HDR-style log-linear histogram: every power-of-two range is split into the same number of linear sub-buckets,
+     * which keeps the relative error of each recorded value below 10^-significantDigits over the whole range.
+     * Recording is a couple of shifts and one increment, no allocation.
+     */
+    class Histogram {
+    public:
+        explicit Histogram(uint64_t highestTrackableValue = 3'600'000'000'000, int significantDigits = 3);
+
+        void record(uint64_t value);
+
+        [[nodiscard]] uint64_t percentile(double percentile) const;
+        [[nodiscard]] uint64_t max() const;
+        [[nodiscard]] uint64_t count() const;
+
+        void reset();
+
+    private:
+        [[nodiscard]] std::size_t countsIndex(uint64_t value) const;
+        [[nodiscard]] uint64_t highestEquivalentValue(std::size_t index) const;
+
+        int subBucketHalfCountMagnitude;
+        uint64_t subBucketHalfCount;
+        uint64_t subBucketMask;
+        uint64_t highestTrackableValue;
+
+        std::vector<uint64_t> counts;
+        uint64_t totalCount = 0;
+        uint64_t maxValue = 0;
+    };
+
+} // namespace web::websocket::subprotocol::echo::client
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_HISTOGRAM_H
@@ -0,0 +1,203 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Replay.h"
+
+#include "Echo.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <chrono>
+#include <log/Logger.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+#define REPLAY_TICK 0.001
+
+namespace web::websocket::subprotocol::echo::client {
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    Replay& Replay::instance() {
+        static Replay replay;
+
+        return replay;
+    }
+
+    bool Replay::load(const std::string& path, double speed) {
+        reader = std::make_unique<capture::Reader>(path);
+        this->speed = speed > 0 ? speed : 1;
+
+        if (!reader->valid()) {
+            reader.reset();
+        } else if ((reader->header().flags & capture::FileHeader::PAYLOAD) == 0) {
+            LOG(INFO) << "Replay: " << path << " holds no payloads, sending filler bytes of the captured sizes";
+        }
+
+        return reader != nullptr;
+    }
+
+    void Replay::start(const std::function<void()>& connect, const std::function<void()>& finished) {
+        this->connect = connect;
+        this->finished = finished;
+
+        started = now();
+
+        timer = core::timer::Timer::intervalTimer(
+            [this]([[maybe_unused]] const std::function<void()>& stop) -> void {
+                tick();
+            },
+            REPLAY_TICK);
+    }
+
+    bool Replay::bind(Echo* echo) {
+        if (pending.empty()) {
+            return false;
+        }
+
+        uint64_t id = pending.front();
+        pending.pop_front();
+
+        Connection& connection = connections[id];
+        connection.echo = echo;
+        bound[echo] = id;
+
+        // Dispatching may close the connection and thus erase it
+        std::vector<Event> backlog = std::move(connection.backlog);
+        for (const Event& event : backlog) {
+            auto it = connections.find(id);
+            if (it == connections.end()) {
+                break;
+            }
+            dispatch(id, it->second, event);
+        }
+
+        return true;
+    }
+
+    void Replay::unbind(Echo* echo) {
+        auto it = bound.find(echo);
+
+        if (it != bound.end()) {
+            connections.erase(it->second);
+            bound.erase(it);
+        }
+    }
+
+    void Replay::tick() {
+        // Capture time which is due now, scaled by the speed
+        uint64_t due = static_cast<uint64_t>(static_cast<double>(now() - started) * speed);
+
+        while (reader != nullptr) {
+            if (!next.has_value()) {
+                const char* payload = nullptr;
+                const capture::Record* record = reader->next(payload);
+
+                if (record == nullptr) {
+                    timer->cancel();
+                    timer.reset();
+
+                    LOG(INFO) << "Replay: capture finished, " << connectionsReplayed << " connections, " << messagesReplayed
+                              << " messages";
+
+                    finished();
+                    break;
+                }
+
+                next = Event{record, payload};
+            }
+
+            if (next->record->time > due) {
+                break;
+            }
+
+            Event event = *next;
+            next.reset();
+
+            uint64_t id = event.record->connection;
+
+            if (event.record->type == capture::Type::OPEN) {
+                connections[id] = Connection();
+                pending.push_back(id);
+                connectionsReplayed++;
+
+                connect();
+            } else {
+                auto it = connections.find(id);
+
+                if (it == connections.end()) {
+                    recordsDropped++;
+                } else if (it->second.echo == nullptr) {
+                    it->second.backlog.push_back(event);
+                } else {
+                    dispatch(id, it->second, event);
+                }
+            }
+        }
+    }
+
+    void Replay::dispatch(uint64_t id, Connection& connection, const Event& event) {
+        switch (event.record->type) {
+            case capture::Type::START:
+                connection.opCode = event.record->opCode;
+                connection.held.reset();
+                connection.started = false;
+                break;
+            case capture::Type::FRAGMENT:
+                if (connection.held.has_value()) {
+                    send(connection, *connection.held, false);
+                }
+                connection.held = event;
+                break;
+            case capture::Type::END:
+                send(connection, connection.held.value_or(Event{event.record, nullptr}), true);
+                connection.held.reset();
+                messagesReplayed++;
+                break;
+            case capture::Type::CLOSE:
+                connection.echo->closeNormally();
+                bound.erase(connection.echo);
+                connections.erase(id);
+                break;
+            case capture::Type::OPEN:
+                break;
+        }
+    }
+
+    void Replay::send(Connection& connection, const Event& fragment, bool last) {
+        static std::string filler;
+
+        const capture::Record& record = *fragment.record;
+        std::size_t length = record.type == capture::Type::FRAGMENT ? record.length : 0;
+        const char* data = fragment.payload;
+
+        if (record.stored < length) {
+            if (filler.size() < length) {
+                filler.assign(length, 'x');
+            }
+            data = filler.data();
+        }
+
+        connection.echo->sendFragment(connection.opCode, data, length, !connection.started, last);
+        connection.started = true;
+    }
+
+} // namespace web::websocket::subprotocol::echo::client
@@ -0,0 +1,104 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_REPLAY_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_REPLAY_H
+
+#include "subprotocol/Capture.h"
+
+#include <core/timer/Timer.h>
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstdint>       // for uint64_t
+#include <deque>         // for deque
+#include <functional>    // for function
+#include <memory>        // for unique_ptr
+#include <optional>      // for optional
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    class Echo;
+
+    /*
+     * Replays a traffic capture of wsechoserver (subprotocol/Capture.h) with its original timing, optionally sped up.
+     * Every captured connection is opened anew at its OPEN time and is bound to the next echo connection coming up,
+     * its messages are sent with the opcodes and fragment boundaries they were captured with. Records due for a
+     * connection which is still handshaking are held back until it is bound.
+     */
+    class Replay {
+    public:
+        static Replay& instance();
+
+        // False if the file is no readable capture
+        bool load(const std::string& path, double speed);
+
+        // 'connect' opens one websocket connection, 'finished' is called once the whole capture has been dispatched
+        void start(const std::function<void()>& connect, const std::function<void()>& finished);
+
+        // Called by Echo: takes the connection for the oldest captured connection waiting for one. False if the
+        // connection is not needed by the replay.
+        bool bind(Echo* echo);
+        void unbind(Echo* echo);
+
+        uint64_t connectionsReplayed = 0;
+        uint64_t messagesReplayed = 0;
+        uint64_t recordsDropped = 0; // Records of connections which could not be (re)established
+
+    private:
+        struct Event {
+            const capture::Record* record;
+            const char* payload;
+        };
+
+        struct Connection {
+            Echo* echo = nullptr;
+            std::vector<Event> backlog;
+
+            int opCode = 0;
+            std::optional<Event> held; // The last fragment is sent along with the end of the message
+            bool started = false;
+        };
+
+        void tick();
+        void dispatch(uint64_t id, Connection& connection, const Event& event);
+        void send(Connection& connection, const Event& fragment, bool last);
+
+        std::unique_ptr<capture::Reader> reader;
+        double speed = 1;
+        uint64_t started = 0;
+
+        std::optional<Event> next;
+
+        std::unordered_map<uint64_t, Connection> connections;
+        std::deque<uint64_t> pending; // Captured connections waiting for their echo connection, in connect order
+        std::unordered_map<const Echo*, uint64_t> bound;
+
+        std::function<void()> connect;
+        std::function<void()> finished;
+        std::optional<core::timer::Timer> timer;
+    };
+
+} // namespace web::websocket::subprotocol::echo::client
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_REPLAY_H
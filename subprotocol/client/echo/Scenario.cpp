@@ -0,0 +1,257 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scenario.h"
+
+#include "Echo.h"
+#include "Statistics.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <exception>
+#include <log/Logger.h>
+#include <utility>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client::scenario {
+
+    // Own wheel for sleeps: 1 ms ticks, one rotation every 4 s
+    static TimerWheel& sleepWheel() {
+        static TimerWheel wheel(0.001, 4096);
+
+        return wheel;
+    }
+
+    static std::size_t scripts = 0;
+
+    static std::function<void()>& allFinished() {
+        static std::function<void()> finished;
+
+        return finished;
+    }
+
+    Script::promise_type::promise_type() {
+        scripts++;
+    }
+
+    Script::promise_type::~promise_type() {
+        if (--scripts == 0 && allFinished()) {
+            allFinished()();
+        }
+    }
+
+    Script Script::promise_type::get_return_object() noexcept {
+        return Script();
+    }
+
+    std::suspend_never Script::promise_type::initial_suspend() noexcept {
+        return {};
+    }
+
+    std::suspend_never Script::promise_type::final_suspend() noexcept {
+        return {};
+    }
+
+    void Script::promise_type::return_void() noexcept {
+    }
+
+    void Script::promise_type::unhandled_exception() noexcept {
+        LOG(ERROR) << "Scenario: script failed with an exception";
+        std::terminate();
+    }
+
+    std::size_t Script::running() {
+        return scripts;
+    }
+
+    void Script::onAllFinished(const std::function<void()>& finished) {
+        allFinished() = finished;
+    }
+
+    Connection* Connection::pendingHead = nullptr;
+    Connection* Connection::pendingTail = nullptr;
+    std::function<void()> Connection::connector;
+
+    Connection::~Connection() {
+        close();
+    }
+
+    bool Connection::Connect::await_ready() const noexcept {
+        return connection->echo != nullptr;
+    }
+
+    void Connection::Connect::await_suspend(std::coroutine_handle<> handle) noexcept {
+        connection->waiting = handle;
+        connection->inbox.clear();
+
+        connection->pending = true;
+        connection->nextPending = nullptr;
+        if (pendingTail != nullptr) {
+            pendingTail->nextPending = connection;
+        } else {
+            pendingHead = connection;
+        }
+        pendingTail = connection;
+
+        connector();
+    }
+
+    bool Connection::Connect::await_resume() const noexcept {
+        return connection->echo != nullptr;
+    }
+
+    bool Connection::NextMessage::await_ready() const noexcept {
+        return !connection->inbox.empty() || connection->echo == nullptr;
+    }
+
+    void Connection::NextMessage::await_suspend(std::coroutine_handle<> handle) noexcept {
+        connection->waiting = handle;
+    }
+
+    std::optional<Message> Connection::NextMessage::await_resume() noexcept {
+        if (connection->inbox.empty()) {
+            return std::nullopt;
+        }
+
+        Message message = std::move(connection->inbox.front());
+        connection->inbox.pop_front();
+
+        return message;
+    }
+
+    Connection::Connect Connection::connect() {
+        return Connect{this};
+    }
+
+    Connection::NextMessage Connection::nextMessage() {
+        return NextMessage{this};
+    }
+
+    Ready<bool> Connection::send(std::string_view text) {
+        return send(1, text);
+    }
+
+    Ready<bool> Connection::sendBinary(std::string_view data) {
+        return send(2, data);
+    }
+
+    Ready<bool> Connection::send(int opCode, std::string_view data) {
+        if (echo == nullptr) {
+            return {false};
+        }
+
+        echo->sendFragment(opCode, data.data(), data.size(), true, true);
+
+        return {true};
+    }
+
+    void Connection::close() {
+        if (echo != nullptr) {
+            echo->scenario = nullptr;
+            echo->closeNormally();
+            echo = nullptr;
+        }
+    }
+
+    bool Connection::connected() const {
+        return echo != nullptr;
+    }
+
+    void Connection::setConnector(const std::function<void()>& connector) {
+        Connection::connector = connector;
+    }
+
+    void Connection::connectFailed() {
+        Connection* connection = pendingHead;
+
+        if (connection != nullptr) {
+            pendingHead = connection->nextPending;
+            if (pendingHead == nullptr) {
+                pendingTail = nullptr;
+            }
+            connection->pending = false;
+
+            connection->resume();
+        }
+    }
+
+    bool Connection::bind(Echo* echo) {
+        Connection* connection = pendingHead;
+
+        if (connection == nullptr) {
+            return false;
+        }
+
+        pendingHead = connection->nextPending;
+        if (pendingHead == nullptr) {
+            pendingTail = nullptr;
+        }
+        connection->pending = false;
+
+        connection->echo = echo;
+        echo->scenario = connection;
+
+        connection->resume();
+
+        return true;
+    }
+
+    void Connection::deliver(int opCode, std::string data) {
+        inbox.push_back({opCode, std::move(data)});
+
+        resume();
+    }
+
+    void Connection::detach() {
+        echo = nullptr;
+
+        resume();
+    }
+
+    void Connection::resume() {
+        if (waiting && !pending) {
+            std::exchange(waiting, nullptr).resume();
+        }
+    }
+
+    Sleep::Sleep(double seconds)
+        : seconds(seconds) {
+    }
+
+    bool Sleep::await_ready() const noexcept {
+        return seconds <= 0;
+    }
+
+    void Sleep::await_suspend(std::coroutine_handle<> handle) noexcept {
+        waiting = handle;
+        sleepWheel().schedule(this, seconds);
+    }
+
+    void Sleep::await_resume() const noexcept {
+    }
+
+    void Sleep::onExpired() {
+        std::exchange(waiting, nullptr).resume();
+    }
+
+    Sleep sleep(double seconds) {
+        return Sleep(seconds);
+    }
+
+} // namespace web::websocket::subprotocol::echo::client::scenario
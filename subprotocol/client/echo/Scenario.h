@@ -0,0 +1,189 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_SCENARIO_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_SCENARIO_H
+
+#include "subprotocol/TimerWheel.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <coroutine>   // for coroutine_handle, suspend_never
+#include <cstddef>     // for std::size_t
+#include <deque>       // for deque
+#include <functional>  // for function
+#include <optional>    // for optional
+#include <string>      // for string
+#include <string_view> // for string_view
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+    class Echo;
+}
+
+namespace web::websocket::subprotocol::echo::client::scenario {
+
+    /*
+     * Coroutine based load scenarios on top of the echo client subprotocol. A scenario script is a coroutine returning
+     * Script which drives its own Connections:
+     *
+     *     Script pingPong() {
+     *         Connection connection;
+     *         if (co_await connection.connect()) {
+     *             co_await connection.send("hello");
+     *             std::optional<Message> echo = co_await connection.nextMessage();
+     *             co_await sleep(0.5);
+     *         }
+     *     }
+     *
+     * Scripts run on the event loop thread and are resumed from the subprotocol callbacks, thus thousands of them are
+     * just thousands of suspended coroutine frames. The awaiters live in these frames and connections waiting for their
+     * websocket are queued intrusively, so awaiting allocates nothing. Only messages arriving while their script is
+     * not waiting for one are queued in an inbox.
+     */
+
+    // A received message
+    struct Message {
+        int opCode;
+        std::string data;
+    };
+
+    /*
+     * Fire and forget coroutine: starts right away and frees its frame once it has finished. Once the last running
+     * script has finished the callback set by onAllFinished() is called.
+     */
+    class Script {
+    public:
+        struct promise_type {
+            promise_type();
+            ~promise_type();
+
+            Script get_return_object() noexcept;
+            std::suspend_never initial_suspend() noexcept;
+            std::suspend_never final_suspend() noexcept;
+            void return_void() noexcept;
+            void unhandled_exception() noexcept;
+        };
+
+        [[nodiscard]] static std::size_t running();
+        static void onAllFinished(const std::function<void()>& finished);
+    };
+
+    // Result of an operation which never suspends, e.g. co_await send(): the message is queued by the websocket layer
+    template <typename Result>
+    struct Ready {
+        Result result;
+
+        bool await_ready() const noexcept {
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> /*handle*/) const noexcept {
+        }
+        Result await_resume() const noexcept {
+            return result;
+        }
+    };
+
+    class Connection {
+    public:
+        Connection() = default;
+        ~Connection();
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        // Opens a websocket connection speaking 'echo', resumes with true once it is up and false if it failed
+        struct Connect {
+            Connection* connection;
+
+            bool await_ready() const noexcept;
+            void await_suspend(std::coroutine_handle<> handle) noexcept;
+            bool await_resume() const noexcept;
+        };
+
+        // Resumes with the next message, or with nothing once the connection is gone
+        struct NextMessage {
+            Connection* connection;
+
+            bool await_ready() const noexcept;
+            void await_suspend(std::coroutine_handle<> handle) noexcept;
+            std::optional<Message> await_resume() noexcept;
+        };
+
+        Connect connect();
+        NextMessage nextMessage();
+
+        // False if the connection is not up
+        Ready<bool> send(std::string_view text);
+        Ready<bool> sendBinary(std::string_view data);
+
+        // Sends a close frame and detaches, the connection can be connect()ed again right away
+        void close();
+
+        [[nodiscard]] bool connected() const;
+
+        // How connect() opens a connection, installed by the load generator
+        static void setConnector(const std::function<void()>& connector);
+
+        // Resolves the oldest pending connect() with false: called on failed connects and upgrades
+        static void connectFailed();
+
+        // Called by Echo: hands its connection to the oldest pending connect(). False if nobody is waiting.
+        static bool bind(Echo* echo);
+        void deliver(int opCode, std::string data);
+        void detach();
+
+    private:
+        Ready<bool> send(int opCode, std::string_view data);
+        void resume();
+
+        Echo* echo = nullptr;
+
+        std::deque<Message> inbox;
+        std::coroutine_handle<> waiting;
+
+        // Intrusive FIFO of the connections waiting in connect()
+        Connection* nextPending = nullptr;
+        bool pending = false;
+
+        static Connection* pendingHead;
+        static Connection* pendingTail;
+        static std::function<void()> connector;
+    };
+
+    // Resumes after 'seconds', with a resolution of 1 ms
+    struct Sleep : private TimerWheel::Entry {
+        explicit Sleep(double seconds);
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        void await_resume() const noexcept;
+
+    private:
+        void onExpired() override;
+
+        double seconds;
+        std::coroutine_handle<> waiting;
+    };
+
+    Sleep sleep(double seconds);
+
+} // namespace web::websocket::subprotocol::echo::client::scenario
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_SCENARIO_H
@@ -0,0 +1,62 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_STATISTICS_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_STATISTICS_H
+
+#include "Histogram.h"
+
+namespace core::socket {
+    class SocketConnection;
+} // namespace core::socket
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstdint>       // for uint64_t
+#include <unordered_map> // for unordered_map
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::client {
+
+    /*
+     * Process wide traffic counters of all echo client connections. Everything runs on the event loop thread,
+     * so plain integers suffice.
+     */
+    struct Statistics {
+        uint64_t connections = 0;
+        uint64_t messagesSent = 0;
+        uint64_t messagesReceived = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+
+        // Round trip times in ns, measured against the intended send time (coordinated omission corrected)
+        Histogram latency;
+
+        // Connect storm: start (steady clock, ns) of every handshake in flight keyed by its connection, completed once
+        // the echo subprotocol is up. Histogram of the handshake times in ns and end of the latest handshake.
+        std::unordered_map<const core::socket::SocketConnection*, uint64_t> handshaking;
+        Histogram handshakes;
+        uint64_t lastHandshake = 0;
+
+        static Statistics& instance();
+    };
+
+} // namespace web::websocket::subprotocol::echo::client
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_CLIENT_STATISTICS_H
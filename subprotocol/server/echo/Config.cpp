@@ -0,0 +1,103 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Config.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    static bool envFlag(const char* name, bool defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::string(value) == "1" || std::string(value) == "true" : defaultValue;
+    }
+
+    static int envInt(const char* name, int defaultValue, int min, int max) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::clamp(static_cast<int>(std::strtol(value, nullptr, 10)), min, max) : defaultValue;
+    }
+
+    static double envDouble(const char* name, double defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? std::strtod(value, nullptr) : defaultValue;
+    }
+
+    static std::size_t envSize(const char* name, std::size_t defaultValue) {
+        const char* value = std::getenv(name);
+
+        return value != nullptr ? static_cast<std::size_t>(std::strtoull(value, nullptr, 10)) : defaultValue;
+    }
+
+    static Config::Overflow envOverflow(const char* name, Config::Overflow defaultValue) {
+        const char* value = std::getenv(name);
+
+        if (value == nullptr) {
+            return defaultValue;
+        } else if (std::string(value) == "latest") {
+            return Config::Overflow::LATEST;
+        } else if (std::string(value) == "close") {
+            return Config::Overflow::CLOSE;
+        }
+
+        return Config::Overflow::DROP;
+    }
+
+    Config Config::fromEnvironment() {
+        Config config;
+
+        config.streaming = envFlag("ECHO_STREAMING", config.streaming);
+        config.validateUtf8 = envFlag("ECHO_VALIDATE_UTF8", config.validateUtf8);
+
+        config.highWater = envSize("ECHO_HIGH_WATER", config.highWater);
+        config.lowWater = std::min(envSize("ECHO_LOW_WATER", config.lowWater), config.highWater);
+        config.overflow = envOverflow("ECHO_OVERFLOW", config.overflow);
+
+        config.pingInterval = std::max(envDouble("ECHO_PING_INTERVAL", config.pingInterval), 0.0);
+        config.pingTimeout = std::max(envDouble("ECHO_PING_TIMEOUT", config.pingTimeout), config.pingInterval);
+        config.idleCompact = std::max(envDouble("ECHO_IDLE_COMPACT", config.idleCompact), 0.0);
+
+        const char* capture = std::getenv("ECHO_CAPTURE");
+        if (capture != nullptr) {
+            config.capture = capture;
+
+            std::string::size_type pid = config.capture.find("%p");
+            if (pid != std::string::npos) {
+                config.capture.replace(pid, 2, std::to_string(getpid()));
+            }
+        }
+        config.captureSeconds = std::max(envDouble("ECHO_CAPTURE_SECONDS", config.captureSeconds), 0.0);
+        config.capturePayload = envFlag("ECHO_CAPTURE_PAYLOAD", config.capturePayload);
+
+        config.offloadThreads = envSize("ECHO_OFFLOAD_THREADS", config.offloadThreads);
+        config.offloadThreshold = envSize("ECHO_OFFLOAD_THRESHOLD", config.offloadThreshold);
+        config.offloadQueue = std::max<std::size_t>(envSize("ECHO_OFFLOAD_QUEUE", config.offloadQueue), 1);
+
+        return config;
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
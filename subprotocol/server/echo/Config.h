@@ -0,0 +1,94 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_CONFIG_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_CONFIG_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <string>  // for string
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Runtime settings of the echo subprotocol. The subprotocol is usually dlopen()ed by the websocket
+     * upgrade machinery, thus the settings are read from the environment once the factory is created.
+     */
+    struct Config {
+        // ECHO_STREAMING=1: forward every fragment as soon as it arrives instead of assembling the whole message
+        bool streaming = false;
+
+        // ECHO_VALIDATE_UTF8=0: echo text messages without checking that they are valid UTF-8 (RFC 6455, 8.1)
+        bool validateUtf8 = true;
+
+        // What happens to a message for a connection whose outbound backlog is above the high water mark
+        enum class Overflow {
+            DROP,   // The message is not delivered to this connection
+            LATEST, // Only the most recent message is kept back and delivered once the backlog has drained
+            CLOSE   // The connection is closed with 1008 (policy violation)
+        };
+
+        // ECHO_HIGH_WATER: outbound bytes queued for a connection (socket write buffer plus deferred messages) at which
+        // it is considered congested
+        std::size_t highWater = 4 * 1024 * 1024;
+
+        // ECHO_LOW_WATER: backlog a congested connection has to drain below before it receives messages again
+        std::size_t lowWater = 1024 * 1024;
+
+        // ECHO_OVERFLOW=drop|latest|close
+        Overflow overflow = Overflow::DROP;
+
+        // ECHO_PING_INTERVAL: seconds without inbound traffic after which a connection is pinged; 0 disables heartbeats
+        double pingInterval = 5;
+
+        // ECHO_PING_TIMEOUT: seconds of unanswered pings after which a connection is closed
+        double pingTimeout = 15;
+
+        // ECHO_IDLE_COMPACT: seconds without inbound messages after which a connection releases its per connection
+        // buffers; 0 disables compaction
+        double idleCompact = 0;
+
+        // ECHO_CAPTURE: file inbound messages of echo connections are recorded to (subprotocol/Capture.h). "%p" is replaced
+        // by the process id so that every worker writes its own file; empty disables capturing.
+        std::string capture;
+
+        // ECHO_CAPTURE_SECONDS: length of the capture window; 0 records until the process exits
+        double captureSeconds = 0;
+
+        // ECHO_CAPTURE_PAYLOAD=0: record fragment sizes only, e.g. when payloads must not be written to disk
+        bool capturePayload = true;
+
+        // ECHO_OFFLOAD_THREADS: worker threads encoding large messages off the event loop (Offload); 0 processes
+        // everything on the event loop thread
+        std::size_t offloadThreads = 0;
+
+        // ECHO_OFFLOAD_THRESHOLD: assembled message size from which on a message is handed to the workers
+        std::size_t offloadThreshold = 64 * 1024;
+
+        // ECHO_OFFLOAD_QUEUE: messages queued per worker thread; beyond that messages are processed inline
+        std::size_t offloadQueue = 256;
+
+        static Config fromEnvironment();
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_CONFIG_H
@@ -18,54 +18,297 @@
 
 #include "Echo.h"
 
+#include "Relay.h"
+#include "subprotocol/Trace.h"
+
 namespace web::websocket {
     class SubProtocolContext;
 }
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include <algorithm>
 #include <cstring>
 #include <log/Logger.h>
+#include <optional>
+#include <utility>
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
-#define PING_INTERVAL 5
-#define MAX_FLYING_PINGS 3
+#define DRAIN_INTERVAL 0.01
 
 namespace web::websocket::subprotocol::echo::server {
 
-    Echo::Echo(SubProtocolContext* subProtocolContext, const std::string& name)
-        : web::websocket::server::SubProtocol(subProtocolContext, name, PING_INTERVAL, MAX_FLYING_PINGS) {
+    std::unordered_set<Echo*> Echo::instances;
+    std::vector<Echo*> Echo::dirty;
+    bool Echo::flushScheduled = false;
+    std::unique_ptr<capture::Writer> Echo::capture;
+    std::unique_ptr<Offload> Echo::offload;
+
+    Echo::Echo(
+        SubProtocolContext* subProtocolContext, const std::string& name, const Config& config, const Greeting& greeting, Topics* topics)
+        : web::websocket::server::SubProtocol(subProtocolContext, name, 0) // Heartbeats run on the shared TimerWheel
+        , config(config)
+        , greeting(greeting)
+        , topics(topics)
+        , streaming(config.streaming && topics == nullptr) { // pubsub commands need the whole message
+        Metrics::instance().attach(&counters);
+        if (topics == nullptr) {
+            instances.insert(this);
+        }
+    }
+
+    Echo::~Echo() {
+        Metrics::instance().detach(&counters);
+        if (compacted) {
+            Metrics::instance().idleConnections--;
+        }
+        instances.erase(this);
+        std::erase(dirty, this);
+
+        if (topics != nullptr) {
+            topics->unsubscribeAll(this);
+        }
+
+        if (processing != nullptr) { // Completed without a connection to report to
+            processing->echo = nullptr;
+        }
+    }
+
+    void Echo::broadcastRelayed(uint8_t opCode, const char* message, std::size_t messageLength) {
+        std::shared_ptr<const Frame> frame = Frame::encode(opCode, message, messageLength);
+
+        for (Echo* echo : instances) {
+            echo->deliver(frame);
+        }
+
+        Metrics::instance().broadcast(instances.size());
+    }
+
+    void Echo::startCapture(const Config& config) {
+        if (capture == nullptr && !config.capture.empty()) {
+            capture = std::make_unique<capture::Writer>(config.capture, config.capturePayload, config.captureSeconds);
+        }
+    }
+
+    void Echo::startOffload(const Config& config) {
+        if (offload == nullptr && config.offloadThreads > 0) {
+            offload = std::make_unique<Offload>(config.offloadThreads, config.offloadQueue);
+        }
     }
 
     void Echo::onConnected() {
         VLOG(0) << "Echo connected:";
 
-        sendMessage("Welcome to SimpleChat");
-        sendMessage("=====================");
+        capturing();
+
+        startHeartbeat(config.pingInterval, config.pingTimeout);
+
+        if (config.idleCompact > 0) {
+            TimerWheel::instance().schedule(&idleTimer, config.idleCompact);
+        }
+
+        if (topics == nullptr) {
+            for (const std::shared_ptr<const Frame>& frame : greeting) {
+                write(frame);
+            }
+        }
     }
 
     void Echo::onMessageStart(int opCode) {
-        VLOG(0) << "Message Start - OpCode: " << opCode;
+        ECHO_TRACE_SAMPLED << "Message Start - OpCode: " << opCode;
+
+        activity();
+
+        if (capturing()) {
+            capture->record(captureId, capture::Type::START, static_cast<uint8_t>(opCode));
+        }
+
+        if (closing) { // Our close frame is out, the peer's remaining messages are ignored
+            return;
+        }
+
+        this->opCode = opCode;
+
+        validating = config.validateUtf8 && opCode == Frame::TEXT;
+        invalid = false;
+        utf8.reset();
     }
 
     void Echo::onMessageData(const char* junk, std::size_t junkLen) {
-        data += std::string(junk, junkLen);
+        ECHO_TRACE_SAMPLED << "Message Fragment: " << junkLen << " bytes";
 
-        VLOG(0) << "Message Fragment: " << std::string(junk, junkLen);
+        activity();
+        counters.bytesIn += junkLen;
+
+        if (captureId != 0) {
+            capture->record(captureId, capture::Type::FRAGMENT, 0, junk, junkLen);
+        }
+
+        if (invalid || closing) {
+            return;
+        }
+
+        if (validating && !utf8.feed(junk, junkLen)) {
+            rejectText();
+        } else if (streaming) {
+            bool first = !streamStarted;
+            streamStarted = true;
+
+            if (Relay::installed() != nullptr) { // Other workers receive the message once it is complete
+                data.append(junk, junkLen);
+            }
+
+            if (first) {
+                fragments = nullptr; // Those of the previous message stay with the receivers still deferring it
+            } else if (fragments != nullptr && fragments.use_count() > 1) {
+                fragments->frames.push_back(Frame::encode(Frame::CONTINUATION, junk, junkLen, false));
+            } else {
+                fragments = nullptr; // No receiver defers this message anymore
+            }
+
+            forEachEcho([this, first, junk, junkLen](Echo* echo) -> void {
+                if (first) {
+                    echo->streamStart(this, opCode, junk, junkLen);
+                } else {
+                    echo->streamFrame(this, junk, junkLen);
+                }
+            });
+        } else {
+            data.append(junk, junkLen);
+        }
     }
 
     void Echo::onMessageEnd() {
-        VLOG(0) << "Message Full Data: " << data;
-        VLOG(0) << "Message End";
-        /*
-                forEachClient([&data = this->data](SubProtocol* client) {
-                    client->sendMessage(data);
-                });
-        */
-        sendBroadcast(data);
+        ECHO_TRACE_SAMPLED << "Message End: " << data.size() << " bytes";
+
+        counters.messagesIn++;
+
+        if (captureId != 0) {
+            capture->record(captureId, capture::Type::END);
+        }
+
+        if (invalid || closing) {
+            return;
+        }
+
+        if (validating && !utf8.complete()) {
+            rejectText();
+        } else if (streaming) {
+            if (fragments != nullptr && fragments.use_count() > 1) {
+                fragments->frames.push_back(Frame::encode(Frame::CONTINUATION, nullptr, 0));
+                fragments->complete = true;
+            }
+            fragments = nullptr;
+
+            forEachEcho([this](Echo* echo) -> void {
+                echo->streamEnd(this, opCode);
+            });
 
+            streamStarted = false;
+
+            Relay* relay = Relay::installed();
+            if (relay != nullptr) {
+                relay->publish(Frame::encode(static_cast<uint8_t>(opCode), data.data(), data.size()));
+                data.clear();
+            }
+        } else if (offload != nullptr && (processing != nullptr || data.size() >= config.offloadThreshold)) {
+            queued.push_back({static_cast<uint8_t>(opCode), std::move(data)});
+            processQueued();
+        } else {
+            process(static_cast<uint8_t>(opCode), data);
+
+            // Back to the pool: an idle connection holds no payload memory
+            data.clear();
+        }
+    }
+
+    void Echo::process(uint8_t opCode, const Buffer& message) {
+        // The opcode travels with the frame: binary payloads are echoed as they are, without any text treatment
+        if (topics != nullptr) {
+            onCommand(opCode, message.view());
+        } else {
+            broadcast(Frame::encode(opCode, message.data(), message.size()));
+        }
+    }
+
+    void Echo::processQueued() {
+        while (processing == nullptr && !queued.empty()) {
+            Queued message = std::move(queued.front());
+            queued.pop_front();
+
+            if (message.data.size() < config.offloadThreshold) { // Queued behind a large one only
+                process(message.opCode, message.data);
+                continue;
+            }
+
+            Processing* submitted = new Processing(this, message.opCode, std::move(message.data));
+            std::unique_ptr<Offload::Job> job(submitted);
+
+            if (offload->submit(job)) {
+                processing = submitted;
+            } else {
+                Metrics::instance().offloadFallbacks++;
+
+                job->run();
+                processed(*submitted);
+            }
+        }
+    }
+
+    void Echo::processed(const Processing& processing) {
+        if (topics != nullptr) {
+            onCommand(processing.opCode, processing.data.view());
+        } else {
+            broadcast(processing.frame);
+        }
+    }
+
+    Echo::Processing::Processing(Echo* echo, uint8_t opCode, Buffer&& data)
+        : echo(echo)
+        , opCode(opCode)
+        , encode(echo->topics == nullptr)
+        , data(std::move(data)) {
+    }
+
+    void Echo::Processing::run() {
+        if (encode) {
+            frame = Frame::encode(opCode, data.data(), data.size());
+        }
+    }
+
+    void Echo::Processing::complete() {
+        if (echo != nullptr) {
+            echo->processing = nullptr;
+            Metrics::instance().offloaded++;
+
+            echo->processed(*this);
+            echo->processQueued();
+        }
+    }
+
+    void Echo::rejectText() {
+        invalid = true;
+        closing = true;
         data.clear();
+        queued.clear();
+
+        Metrics::instance().invalidUtf8++;
+
+        abortStream();
+
+        flushOutbox();
+        sendClose(1007, "Invalid UTF-8", 13);
+    }
+
+    void Echo::abortStream() {
+        if (streamStarted) {
+            forEachEcho([this](Echo* echo) -> void {
+                echo->streamAbort(this);
+            });
+
+            streamStarted = false;
+        }
     }
 
     void Echo::onMessageError(uint16_t errnum) {
@@ -73,17 +316,465 @@ namespace web::websocket::subprotocol::echo::server {
     }
 
     void Echo::onPongReceived() {
-        VLOG(0) << "Pong received";
-        flyingPings = 0;
+        ECHO_TRACE_SAMPLED << "Pong received";
+
+        heartbeatActivity();
     }
 
     void Echo::onDisconnected() {
         VLOG(0) << "Echo disconnected:";
+
+        stopHeartbeat();
+        TimerWheel::instance().cancel(&idleTimer);
+
+        if (captureId != 0) {
+            capture->record(captureId, capture::Type::CLOSE);
+        }
+
+        if (draining) {
+            drainTimer->cancel();
+            draining = false;
+        }
+
+        if (streamStarted) {
+            forEachEcho(
+                [this](Echo* echo) -> void {
+                    echo->streamAbort(this);
+                },
+                true);
+        }
     }
 
     bool Echo::onSignal(int sig) {
         LOG(INFO) << "SubProtocol 'echo' exit dot to '" << strsignal(sig) << "' (SIG" << sigabbrev_np(sig) << " = " << sig << ")";
+
+        if (capture != nullptr) {
+            capture->stop();
+        }
         return true;
     }
 
+    bool Echo::capturing() {
+        if (captureId == 0 && capture != nullptr && capture->recording()) {
+            captureId = capture->open();
+        }
+
+        return captureId != 0;
+    }
+
+    void Echo::onHeartbeatPing() {
+        flushOutbox();
+        sendPing();
+    }
+
+    void Echo::onHeartbeatTimeout() {
+        VLOG(0) << "Echo: no pong within " << config.pingTimeout << " s, closing";
+
+        Metrics::instance().pingTimeouts++;
+        getSocketConnection()->close();
+    }
+
+    void Echo::activity() {
+        heartbeatActivity();
+        active = true;
+
+        if (compacted) {
+            compacted = false;
+            Metrics::instance().idleConnections--;
+
+            TimerWheel::instance().schedule(&idleTimer, config.idleCompact);
+        }
+    }
+
+    void Echo::compact() {
+        data.clear();
+
+        if (outbox.empty()) {
+            std::vector<std::shared_ptr<const Frame>>().swap(outbox);
+        }
+        if (dropping.empty()) {
+            std::unordered_set<const Echo*>().swap(dropping);
+        }
+
+        compacted = true;
+
+        Metrics& metrics = Metrics::instance();
+        metrics.idleConnections++;
+        metrics.compactions++;
+
+        if (metrics.idleConnections == metrics.connections()) { // Nobody is going to reuse the cached buffers soon
+            BufferPool::instance().trim();
+        }
+    }
+
+    Echo::IdleTimer::IdleTimer(Echo* echo)
+        : echo(echo) {
+    }
+
+    void Echo::IdleTimer::onExpired() {
+        // Not in the middle of a message: its fragments may well be minutes apart
+        if (echo->active || !echo->data.empty() || echo->streamStarted || echo->processing != nullptr) {
+            echo->active = false;
+            TimerWheel::instance().schedule(this, echo->config.idleCompact);
+        } else {
+            echo->compact();
+        }
+    }
+
+    void Echo::forEachEcho(const std::function<void(Echo*)>& callback, bool excludeSelf) {
+        forEachClient(
+            [&callback](Super* client) -> void {
+                Echo* echo = dynamic_cast<Echo*>(client);
+                if (echo != nullptr && echo->topics == nullptr) { // pubsub connections receive their topics only
+                    callback(echo);
+                }
+            },
+            excludeSelf);
+    }
+
+    void Echo::onCommand(uint8_t opCode, std::string_view command) {
+        // "sub <topic>", "unsub <topic>" or "pub <topic> <payload>"
+        std::string_view verb = command.substr(0, command.find(' '));
+        std::string_view argument = command.substr(std::min(verb.size() + 1, command.size()));
+
+        if (verb == "sub" && !argument.empty()) {
+            topics->subscribe(std::string(argument), this);
+        } else if (verb == "unsub" && !argument.empty()) {
+            topics->unsubscribe(std::string(argument), this);
+        } else if (verb == "pub") {
+            std::string_view topic = argument.substr(0, argument.find(' '));
+
+            publish(opCode, topic, argument.substr(std::min(topic.size() + 1, argument.size())));
+        } else {
+            send(Frame::TEXT, "error: unknown command", 22);
+        }
+    }
+
+    void Echo::publish(uint8_t opCode, std::string_view topic, std::string_view message) {
+        const Topics::Subscribers* subscribers = topics->subscribers(topic);
+
+        if (subscribers != nullptr) {
+            std::shared_ptr<const Frame> frame = Frame::encode(opCode, message.data(), message.size());
+
+            for (Echo* echo : *subscribers) {
+                echo->deliver(frame);
+            }
+        }
+
+        Metrics::instance().broadcast(subscribers != nullptr ? subscribers->size() : 0);
+    }
+
+    void Echo::streamStart(Echo* origin, int opCode, const char* junk, std::size_t junkLen) {
+        if (!admit()) {
+            dropping.insert(origin);
+            overflow(nullptr);
+        } else if (streamOwner == nullptr) {
+            streamOwner = origin;
+            sendStart(opCode, junk, junkLen);
+        } else {
+            deferred.push_back({origin, origin->shareFragments(junk, junkLen), nullptr, junkLen});
+            deferredBytes += junkLen;
+        }
+    }
+
+    void Echo::streamFrame(const Echo* origin, const char* junk, std::size_t junkLen) {
+        if (streamOwner == origin) {
+            if (!admit()) {
+                // Partly sent already: the message can neither be dropped nor kept back, whatever the policy
+                closeCongested();
+                return;
+            }
+
+            flushOutbox();
+            sendMessageFrame(junk, junkLen);
+            counters.bytesOut += junkLen;
+        } else {
+            std::list<Deferred>::iterator message = findDeferred(origin);
+
+            if (message == deferred.end()) {
+                return;
+            } else if (admit()) { // The origin has appended the fragment to the shared ones already
+                message->bytes += junkLen;
+                deferredBytes += junkLen;
+            } else { // Nothing has been sent yet, thus it is dropped like a message arriving at a congested connection
+                deferredBytes -= message->bytes;
+                deferred.erase(message);
+
+                dropping.insert(origin);
+                overflow(nullptr);
+            }
+        }
+    }
+
+    void Echo::streamEnd(const Echo* origin, int opCode) {
+        if (dropping.erase(origin) > 0 || closing) { // Nothing may follow our close frame, not even the end of a started message
+            return;
+        }
+
+        if (streamOwner == origin) {
+            flushOutbox();
+            sendMessageEnd(nullptr, 0);
+            streamOwner = nullptr;
+
+            flushDeferred();
+        } else if (findDeferred(origin) == deferred.end()) { // Empty message: no data fragment has been announced
+            enqueue(Frame::encode(static_cast<uint8_t>(opCode), nullptr, 0));
+        } // Otherwise the origin has marked the shared fragments complete
+    }
+
+    void Echo::streamAbort(const Echo* origin) {
+        if (closing) {
+            return;
+        } else if (streamOwner == origin) {
+            // The origin vanished mid-message. A websocket message can not be aborted, and ending it would pass the
+            // truncated payload on as complete (for text possibly cut within a UTF-8 sequence), thus close instead.
+            closing = true;
+
+            flushOutbox();
+            sendClose(1011, "Message aborted", 15);
+
+            abortStream();
+        } else {
+            dropping.erase(origin);
+
+            deferred.remove_if([this, origin](const Deferred& message) -> bool {
+                bool aborted = message.fragments != nullptr && message.origin == origin && !message.fragments->complete;
+                if (aborted) {
+                    deferredBytes -= message.bytes;
+                }
+                return aborted;
+            });
+        }
+    }
+
+    std::list<Echo::Deferred>::iterator Echo::findDeferred(const Echo* origin) {
+        return std::find_if(deferred.begin(), deferred.end(), [origin](const Deferred& message) -> bool {
+            return message.fragments != nullptr && message.origin == origin && !message.fragments->complete;
+        });
+    }
+
+    std::shared_ptr<const Echo::Fragments> Echo::shareFragments(const char* junk, std::size_t junkLen) {
+        if (fragments == nullptr) { // Called with the first fragment only: deferring starts with a message
+            fragments = std::make_shared<Fragments>();
+            fragments->frames.push_back(Frame::encode(static_cast<uint8_t>(opCode), junk, junkLen, false));
+        }
+
+        return fragments;
+    }
+
+    void Echo::flushDeferred() {
+        while (streamOwner == nullptr && !deferred.empty()) {
+            Deferred& message = deferred.front();
+            deferredBytes -= message.bytes;
+
+            if (message.frame != nullptr) {
+                write(message.frame);
+            } else {
+                for (const std::shared_ptr<const Frame>& frame : message.fragments->frames) {
+                    write(frame);
+                }
+
+                if (!message.fragments->complete) { // Still in flight: continue it as the current outbound stream
+                    streamOwner = message.origin;
+                }
+            }
+
+            deferred.pop_front();
+        }
+    }
+
+    void Echo::broadcast(const std::shared_ptr<const Frame>& frame) {
+        std::size_t fanOut = 0;
+
+        forEachEcho([&frame, &fanOut](Echo* echo) -> void {
+            echo->deliver(frame);
+            fanOut++;
+        });
+
+        Metrics::instance().broadcast(fanOut);
+
+        Relay* relay = Relay::installed();
+        if (relay != nullptr) {
+            relay->publish(frame);
+        }
+    }
+
+    void Echo::deliver(const std::shared_ptr<const Frame>& frame) {
+        if (!admit()) {
+            overflow(frame);
+        } else {
+            if (latest != nullptr) { // Congestion is over: the kept back message goes first
+                enqueue(std::exchange(latest, nullptr));
+            }
+
+            enqueue(frame);
+        }
+    }
+
+    void Echo::enqueue(const std::shared_ptr<const Frame>& frame) {
+        if (streamOwner == nullptr) {
+            write(frame);
+        } else {
+            deferred.push_back({nullptr, nullptr, frame, frame->size()});
+            deferredBytes += frame->size();
+        }
+    }
+
+    std::size_t Echo::backlog() {
+        core::socket::SocketConnection* socketConnection = getSocketConnection();
+
+        return socketConnection->getTotalQueued() - socketConnection->getTotalSent() + outboxBytes + deferredBytes;
+    }
+
+    bool Echo::admit() {
+        if (closing) {
+            return false;
+        }
+
+        // Hysteresis: congested at the high water mark, relieved only below the low one
+        std::size_t queued = backlog();
+        if (congested && queued <= config.lowWater) {
+            congested = false;
+        } else if (!congested && queued >= config.highWater) {
+            congested = true;
+            Metrics::instance().congestions++;
+        }
+
+        return !congested;
+    }
+
+    void Echo::overflow(const std::shared_ptr<const Frame>& frame) {
+        if (closing) { // Not congestion: nothing is delivered after our close frame
+            return;
+        }
+
+        switch (config.overflow) {
+            case Config::Overflow::LATEST:
+                if (frame != nullptr) {
+                    if (latest != nullptr) {
+                        Metrics::instance().overflowSuperseded++;
+                    }
+                    latest = frame;
+
+                    // Nothing might be broadcasted anymore, thus check for relief periodically
+                    if (!draining) {
+                        draining = true;
+                        drainTimer = core::timer::Timer::intervalTimer(
+                            [this](const std::function<void()>& stop) -> void {
+                                if (drainLatest()) {
+                                    draining = false;
+                                    stop();
+                                }
+                            },
+                            DRAIN_INTERVAL);
+                    }
+                    break;
+                }
+                [[fallthrough]]; // A streamed message can not be kept back
+            case Config::Overflow::DROP:
+                Metrics::instance().overflowDropped++;
+                break;
+            case Config::Overflow::CLOSE:
+                closeCongested();
+                break;
+        }
+    }
+
+    void Echo::closeCongested() {
+        if (!closing) {
+            closing = true;
+            Metrics::instance().overflowClosed++;
+
+            flushOutbox();
+            sendClose(1008, "Too slow", 8);
+
+            abortStream(); // Its further fragments are ignored
+        }
+    }
+
+    bool Echo::drainLatest() {
+        if (latest == nullptr) {
+            return true;
+        } else if (admit()) {
+            enqueue(std::exchange(latest, nullptr));
+            return true;
+        }
+
+        return false;
+    }
+
+    void Echo::write(const std::shared_ptr<const Frame>& frame) {
+        if (outbox.empty()) {
+            dirty.push_back(this);
+
+            if (!flushScheduled) { // Fires in the next event loop iteration, after all events of this one are dispatched
+                flushScheduled = true;
+                core::timer::Timer::singleshotTimer(
+                    []() -> void {
+                        flushScheduled = false;
+                        flushAll();
+                    },
+                    0);
+            }
+        }
+
+        outbox.push_back(frame);
+        outboxBytes += frame->size();
+    }
+
+    void Echo::flushAll() {
+        for (Echo* echo : dirty) {
+            echo->flushOutbox();
+        }
+        dirty.clear();
+    }
+
+    void Echo::flushOutbox() {
+        if (outbox.empty()) {
+            return;
+        }
+
+        // Bypasses the per-connection frame encoder: the frames are written as they are. sendToPeer() only appends to the
+        // socket's write buffer, which is written in one go when the event loop gets to it, so gathering the frames
+        // beforehand would merely copy every payload twice.
+        for (const std::shared_ptr<const Frame>& frame : outbox) {
+            getSocketConnection()->sendToPeer(frame->data(), frame->size());
+
+            if (frame->getOpCode() != Frame::CONTINUATION) { // A deferred streamed message is counted by its first fragment
+                counters.messagesOut++;
+            }
+            counters.bytesOut += frame->payloadSize();
+        }
+        counters.writes++;
+
+        outbox.clear();
+        outboxBytes = 0;
+    }
+
+    void Echo::send(int opCode, const char* message, std::size_t messageLength) {
+        flushOutbox();
+
+        counters.messagesOut++;
+        counters.bytesOut += messageLength;
+
+        if (opCode == Frame::BINARY) {
+            sendMessage(message, messageLength);
+        } else {
+            sendMessage(std::string(message, messageLength));
+        }
+    }
+
+    void Echo::sendStart(int opCode, const char* message, std::size_t messageLength) {
+        flushOutbox();
+
+        counters.messagesOut++;
+        counters.bytesOut += messageLength;
+
+        if (opCode == Frame::BINARY) {
+            sendMessageStart(message, messageLength);
+        } else {
+            sendMessageStart(std::string(message, messageLength));
+        }
+    }
+
 } // namespace web::websocket::subprotocol::echo::server
@@ -19,29 +19,73 @@
 #ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHO_H
 #define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHO_H
 
+#include "Config.h"
+#include "Frame.h"
+#include "Metrics.h"
+#include "Offload.h"
+#include "Topics.h"
+#include "Utf8Validator.h"
+#include "subprotocol/Capture.h"
+#include "subprotocol/Heartbeat.h"
+#include "subprotocol/TimerWheel.h"
+
+#include <core/timer/Timer.h>
 #include <web/websocket/server/SubProtocol.h>
 
 namespace web::websocket {
     class SubProtocolContext;
 }
 
+namespace echobench {
+    struct Driver;
+}
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
-#include <cstddef> // for std::size_t
-#include <cstdint> // for uint16_t
-#include <string>  // for string, basic_string
+#include <cstddef>       // for std::size_t
+#include <cstdint>       // for uint16_t
+#include <functional>    // for function
+#include <list>          // for list
+#include <memory>        // for shared_ptr
+#include <optional>      // for optional
+#include <string>        // for string, basic_string
+#include <string_view>   // for string_view
+#include <unordered_set> // for unordered_set
+#include <vector>        // for vector
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 namespace web::websocket::subprotocol::echo::server {
 
-    class Echo : public web::websocket::server::SubProtocol {
+    class Echo
+        : public web::websocket::server::SubProtocol
+        , private Heartbeat {
     private:
         using Super = web::websocket::server::SubProtocol;
 
     public:
-        explicit Echo(SubProtocolContext* subProtocolContext, const std::string& name);
-        ~Echo() override = default;
+        // Constant frames sent on connect, encoded once by the factory
+        using Greeting = std::vector<std::shared_ptr<const Frame>>;
+
+        // With 'topics' set the connection speaks the pubsub flavour: it only receives messages of the topics it subscribed to
+        explicit Echo(SubProtocolContext* subProtocolContext,
+                      const std::string& name,
+                      const Config& config,
+                      const Greeting& greeting,
+                      Topics* topics = nullptr);
+        ~Echo() override;
+
+        // Invokes the websocket callbacks without a socket (bench/echobench.cpp)
+        friend struct ::echobench::Driver;
+
+        // Delivers a broadcast received through a Relay to all echo connections of this event loop
+        static void broadcastRelayed(uint8_t opCode, const char* message, std::size_t messageLength);
+
+        // Starts recording inbound traffic if Config::capture is set; once per process
+        static void startCapture(const Config& config);
+
+        // Starts the worker threads if Config::offloadThreads is set; once per process
+        static void startOffload(const Config& config);
 
     private:
         void onConnected() override;
@@ -53,9 +97,172 @@ namespace web::websocket::subprotocol::echo::server {
         void onDisconnected() override;
         [[nodiscard]] bool onSignal(int sig) override;
 
-        std::string data;
+        void onHeartbeatPing() override;
+        void onHeartbeatTimeout() override;
+
+        // Inbound message traffic: feeds the heartbeat and wakes up a compacted connection
+        void activity();
+
+        // Releases what an idle connection does not need: assembly buffers and spare container capacity. Everything is
+        // set up again on demand by the next message.
+        void compact();
+
+        class IdleTimer : public TimerWheel::Entry {
+        public:
+            explicit IdleTimer(Echo* echo);
+
+        private:
+            void onExpired() override;
+
+            Echo* echo;
+        };
+
+        // Fails the current text message with 1007 (invalid frame payload data)
+        void rejectText();
+
+        // Terminates the message this connection is currently streaming at every receiver
+        void abortStream();
+
+        // Broadcasts a complete inbound message or runs it as pubsub command
+        void process(uint8_t opCode, const Buffer& message);
+
+        // Large messages are encoded into their frame on an offload worker thread
+        class Processing : public Offload::Job {
+        public:
+            Processing(Echo* echo, uint8_t opCode, Buffer&& data);
+
+            void run() override;
+            void complete() override;
+
+            Echo* echo; // Reset if the connection goes away meanwhile
+
+            const uint8_t opCode;
+            const bool encode;
+
+            Buffer data;
+            std::shared_ptr<const Frame> frame;
+        };
+
+        void processQueued();
+        void processed(const Processing& processing);
+
+        // Plain echo connections of this channel
+        void forEachEcho(const std::function<void(Echo*)>& callback, bool excludeSelf = false);
+
+        // pubsub flavour
+        void onCommand(uint8_t opCode, std::string_view command);
+        void publish(uint8_t opCode, std::string_view topic, std::string_view message);
+
+        // Outbound side of streaming mode: called on each receiving connection by the connection 'origin'
+        void streamStart(Echo* origin, int opCode, const char* junk, std::size_t junkLen);
+        void streamFrame(const Echo* origin, const char* junk, std::size_t junkLen);
+        void streamEnd(const Echo* origin, int opCode);
+        void streamAbort(const Echo* origin);
+        void flushDeferred();
+
+        // Encode once, deliver the very same frame to every connection
+        void broadcast(const std::shared_ptr<const Frame>& frame);
+        void deliver(const std::shared_ptr<const Frame>& frame);
+        void enqueue(const std::shared_ptr<const Frame>& frame);
+
+        // Outbound backpressure, see Config::highWater and Config::overflow. A null frame denotes a streamed message.
+        std::size_t backlog();
+        bool admit();
+        void overflow(const std::shared_ptr<const Frame>& frame);
+        void closeCongested();
+        bool drainLatest();
+
+        static std::unordered_set<Echo*> instances;
+
+        // Connections already open when the capture starts join it with their next message
+        bool capturing();
+
+        static std::unique_ptr<capture::Writer> capture;
+        uint64_t captureId = 0;
+
+        // Worker thread offload, see Config::offloadThreshold. A connection has at most one message at the workers,
+        // messages completed meanwhile queue up behind it. This keeps them in order.
+        struct Queued {
+            uint8_t opCode;
+            Buffer data;
+        };
+
+        static std::unique_ptr<Offload> offload;
+        Processing* processing = nullptr;
+        std::list<Queued> queued;
+
+        // Pre-encoded frames are collected during one event loop iteration and handed to the socket in one go. Anything
+        // sent through the websocket layer directly flushes them first to keep the order.
+        void write(const std::shared_ptr<const Frame>& frame);
+        void flushOutbox();
+        static void flushAll();
+
+        std::vector<std::shared_ptr<const Frame>> outbox;
+        std::size_t outboxBytes = 0;
+
+        static std::vector<Echo*> dirty;
+        static bool flushScheduled;
+
+        void send(int opCode, const char* message, std::size_t messageLength);
+        void sendStart(int opCode, const char* message, std::size_t messageLength);
+
+        const Config& config;
+        const Greeting& greeting;
+        Topics* topics;
+        const bool streaming;
+
+        Metrics::Counters counters;
+
+        Buffer data; // The message being assembled; when streaming only for a Relay
+
+        int opCode = 0;
+        bool streamStarted = false;
+
+        // The fragments of the message this connection is streaming, pre-encoded as frames for the receivers which
+        // have to defer it. Created by the first of them and shared by all: a deferred message is held once, however
+        // many receivers defer it. The fragments are only appended while some receiver still holds them.
+        struct Fragments {
+            std::vector<std::shared_ptr<const Frame>> frames;
+            bool complete = false;
+        };
+
+        std::shared_ptr<Fragments> fragments;
+        std::shared_ptr<const Fragments> shareFragments(const char* junk, std::size_t junkLen);
+
+        Utf8Validator utf8;
+        bool validating = false;
+        bool invalid = false;
+
+        // A connection can only carry one fragmented message at a time. Messages of other origins arriving
+        // meanwhile are deferred and flushed in order once the current outbound message is finished. Their bytes count
+        // into the backlog, thus a receiver drops a deferred message once it crosses the high water mark: memory stays
+        // bounded by one copy of each deferred message plus highWater per receiver.
+        struct Deferred {
+            const Echo* origin;
+            std::shared_ptr<const Fragments> fragments; // Set for streamed messages
+            std::shared_ptr<const Frame> frame;         // Set for pre-encoded complete messages
+            std::size_t bytes;                          // Accounted in deferredBytes
+        };
+
+        const Echo* streamOwner = nullptr;
+        std::list<Deferred> deferred;
+        std::size_t deferredBytes = 0;
+
+        // The message of 'origin' still being streamed into 'deferred'
+        std::list<Deferred>::iterator findDeferred(const Echo* origin);
+
+        bool congested = false;
+        bool closing = false; // Close frame sent: nothing is received or delivered anymore
+        std::shared_ptr<const Frame> latest;      // Kept back by Overflow::LATEST
+        std::unordered_set<const Echo*> dropping; // Origins whose currently streamed message is not forwarded
+        std::optional<core::timer::Timer> drainTimer;
+        bool draining = false;
 
-        int flyingPings = 0;
+        // Idle compaction, see Config::idleCompact. Traffic only sets 'active', the timer rechecks it once per period,
+        // thus a connection is compacted after one to two periods without inbound messages.
+        IdleTimer idleTimer{this};
+        bool active = false;
+        bool compacted = false;
     };
 
 } // namespace web::websocket::subprotocol::echo::server
@@ -23,11 +23,23 @@
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 #define NAME "echo"
+#define PUBSUB_NAME "pubsub"
 
 namespace web::websocket::subprotocol::echo::server {
 
+    EchoFactory::EchoFactory(const std::string& name, bool withTopics)
+        : Super(name)
+        , config(Config::fromEnvironment())
+        , greeting({Frame::encode(Frame::TEXT, "Welcome to SimpleChat", 21), Frame::encode(Frame::TEXT, "=====================", 21)})
+        , topics(withTopics ? std::make_unique<Topics>() : nullptr) {
+        if (!withTopics) { // Loaded as a library of its own, pubsub would truncate the same file
+            Echo::startCapture(config);
+        }
+        Echo::startOffload(config);
+    }
+
     Echo* EchoFactory::create(SubProtocolContext* subProtocolContext) {
-        return new Echo(subProtocolContext, getName());
+        return new Echo(subProtocolContext, getName(), config, greeting, topics.get());
     }
 
 } // namespace web::websocket::subprotocol::echo::server
@@ -35,3 +47,7 @@ namespace web::websocket::subprotocol::echo::server {
 extern "C" void* echoServerSubProtocolFactory() {
     return new web::websocket::subprotocol::echo::server::EchoFactory(NAME);
 }
+
+extern "C" void* pubsubServerSubProtocolFactory() {
+    return new web::websocket::subprotocol::echo::server::EchoFactory(PUBSUB_NAME, true);
+}
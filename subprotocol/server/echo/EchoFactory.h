@@ -19,26 +19,40 @@
 #ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHOINTERFACE_H
 #define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_ECHOINTERFACE_H
 
+#include "Config.h"
 #include "Echo.h"
+#include "Topics.h"
 
 #include <web/websocket/SubProtocolFactory.h>
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+#include <memory>
+#include <string>
+
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 namespace web::websocket::subprotocol::echo::server {
 
     class EchoFactory : public web::websocket::SubProtocolFactory<Echo> {
+    private:
+        using Super = web::websocket::SubProtocolFactory<Echo>;
+
     public:
-        using web::websocket::SubProtocolFactory<Echo>::SubProtocolFactory;
+        // With 'withTopics' the factory serves the pubsub flavour, sharing one subscription index among its connections
+        explicit EchoFactory(const std::string& name, bool withTopics = false);
 
     private:
         Echo* create(web::websocket::SubProtocolContext* subProtocolContext) override;
+
+        const Config config;
+        const Echo::Greeting greeting;
+        std::unique_ptr<Topics> topics;
     };
 
 } // namespace web::websocket::subprotocol::echo::server
 
 extern "C" void* echoServerSubProtocolFactory();
+extern "C" void* pubsubServerSubProtocolFactory();
 
 #endif // ECHOINTERFACE_H
@@ -0,0 +1,80 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Frame.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    std::shared_ptr<const Frame> Frame::encode(uint8_t opCode, const char* payload, std::size_t payloadLength, bool fin) {
+        std::shared_ptr<Frame> frame(new Frame());
+
+        char header[10];
+        std::size_t headerLength = 2;
+
+        header[0] = static_cast<char>((fin ? 0x80 : 0x00) | (opCode & 0x0F)); // No RSV bits
+
+        if (payloadLength < 126) {
+            header[1] = static_cast<char>(payloadLength); // Server frames are never masked
+        } else if (payloadLength <= 0xFFFF) {
+            header[1] = 126;
+            for (std::size_t i = 0; i < 2; i++) {
+                header[2 + i] = static_cast<char>(payloadLength >> (8 * (1 - i)));
+            }
+            headerLength += 2;
+        } else {
+            header[1] = 127;
+            for (std::size_t i = 0; i < 8; i++) {
+                header[2 + i] = static_cast<char>(static_cast<uint64_t>(payloadLength) >> (8 * (7 - i)));
+            }
+            headerLength += 8;
+        }
+
+        frame->buffer.reserve(headerLength + payloadLength);
+        frame->buffer.append(header, headerLength);
+        frame->buffer.append(payload, payloadLength);
+        frame->headerLength = headerLength;
+        frame->opCode = opCode;
+
+        return frame;
+    }
+
+    const char* Frame::data() const {
+        return buffer.data();
+    }
+
+    std::size_t Frame::size() const {
+        return buffer.size();
+    }
+
+    const char* Frame::payload() const {
+        return buffer.data() + headerLength;
+    }
+
+    std::size_t Frame::payloadSize() const {
+        return buffer.size() - headerLength;
+    }
+
+    uint8_t Frame::getOpCode() const {
+        return opCode;
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
@@ -0,0 +1,68 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_FRAME_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_FRAME_H
+
+#include "subprotocol/BufferPool.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <cstdint> // for uint8_t
+#include <memory>  // for shared_ptr
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * A complete, unmasked server-to-client websocket frame (header and payload) encoded exactly once. Frames
+     * are immutable and shared by reference between all connections they are delivered to.
+     */
+    class Frame {
+    public:
+        static constexpr uint8_t CONTINUATION = 0x00;
+        static constexpr uint8_t TEXT = 0x01;
+        static constexpr uint8_t BINARY = 0x02;
+
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        // 'fin' cleared encodes one fragment of a message, continued by CONTINUATION frames (RFC 6455 5.4)
+        static std::shared_ptr<const Frame> encode(uint8_t opCode, const char* payload, std::size_t payloadLength, bool fin = true);
+
+        [[nodiscard]] const char* data() const;
+        [[nodiscard]] std::size_t size() const;
+
+        [[nodiscard]] const char* payload() const;
+        [[nodiscard]] std::size_t payloadSize() const;
+
+        [[nodiscard]] uint8_t getOpCode() const;
+
+    private:
+        Frame() = default;
+
+        Buffer buffer; // Back to the pool once the last recipient has written the frame
+        std::size_t headerLength = 0;
+        uint8_t opCode = 0;
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_FRAME_H
@@ -0,0 +1,204 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Metrics.h"
+
+#include "subprotocol/BufferPool.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <unistd.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    Metrics::Counters& Metrics::Counters::operator+=(const Counters& counters) {
+        messagesIn += counters.messagesIn;
+        bytesIn += counters.bytesIn;
+        messagesOut += counters.messagesOut;
+        bytesOut += counters.bytesOut;
+        writes += counters.writes;
+
+        return *this;
+    }
+
+    static_assert(std::is_trivially_copyable_v<Metrics::Snapshot> && sizeof(Metrics::Snapshot) % sizeof(uint64_t) == 0,
+                  "snapshots are summed and shared between processes as arrays of uint64_t");
+
+    Metrics::Snapshot& Metrics::Snapshot::operator+=(const Snapshot& snapshot) {
+        std::array<uint64_t, SNAPSHOT_FIELDS> sum;
+        std::array<uint64_t, SNAPSHOT_FIELDS> values;
+
+        std::memcpy(sum.data(), this, sizeof(Snapshot));
+        std::memcpy(values.data(), &snapshot, sizeof(Snapshot));
+
+        for (std::size_t field = 0; field < SNAPSHOT_FIELDS; field++) {
+            sum[field] += values[field];
+        }
+
+        std::memcpy(static_cast<void*>(this), sum.data(), sizeof(Snapshot));
+
+        return *this;
+    }
+
+    Metrics& Metrics::instance() {
+        static Metrics metrics;
+
+        return metrics;
+    }
+
+    void Metrics::attach(const Counters* counters) {
+        live.insert(counters);
+        connectionsTotal++;
+    }
+
+    void Metrics::detach(const Counters* counters) {
+        if (live.erase(counters) > 0) {
+            retired += *counters;
+        }
+    }
+
+    void Metrics::broadcast(std::size_t fanOut) {
+        std::size_t bucket = 0;
+        while (bucket < fanOutBounds.size() && fanOut > fanOutBounds[bucket]) {
+            bucket++;
+        }
+
+        fanOutBuckets[bucket]++;
+        fanOutSum += fanOut;
+        broadcasts++;
+    }
+
+    std::size_t Metrics::connections() const {
+        return live.size();
+    }
+
+    // Resident set size of the whole process, 0 where /proc is not available
+    static uint64_t residentBytes() {
+        uint64_t pages = 0;
+        uint64_t residentPages = 0;
+
+        std::ifstream("/proc/self/statm") >> pages >> residentPages;
+
+        return residentPages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    static void counter(std::ostringstream& out, const char* name, const char* help, uint64_t value, const char* type = "counter") {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+        out << name << " " << value << "\n";
+    }
+
+    Metrics::Snapshot Metrics::snapshot() const {
+        Snapshot snapshot;
+
+        snapshot.total = retired;
+        for (const Counters* counters : live) {
+            snapshot.total += *counters;
+        }
+
+        snapshot.connections = live.size();
+        snapshot.connectionsTotal = connectionsTotal;
+        snapshot.upgrades = upgrades;
+        snapshot.upgradeFailures = upgradeFailures;
+        snapshot.tlsHandshakes = tlsHandshakes;
+        snapshot.tlsResumptions = tlsResumptions;
+        snapshot.pingTimeouts = pingTimeouts;
+        snapshot.invalidUtf8 = invalidUtf8;
+        snapshot.bufferPoolHits = BufferPool::instance().hits;
+        snapshot.bufferPoolMisses = BufferPool::instance().misses;
+        snapshot.bufferPoolCachedBytes = BufferPool::instance().cachedBytes();
+        snapshot.relayDrops = relayDrops;
+        snapshot.congestions = congestions;
+        snapshot.overflowDropped = overflowDropped;
+        snapshot.overflowSuperseded = overflowSuperseded;
+        snapshot.overflowClosed = overflowClosed;
+        snapshot.idleConnections = idleConnections;
+        snapshot.compactions = compactions;
+        snapshot.offloaded = offloaded;
+        snapshot.offloadFallbacks = offloadFallbacks;
+        snapshot.residentBytes = residentBytes();
+        snapshot.fanOutBuckets = fanOutBuckets;
+        snapshot.fanOutSum = fanOutSum;
+        snapshot.broadcasts = broadcasts;
+
+        return snapshot;
+    }
+
+    std::string Metrics::render() const {
+        return render(snapshot());
+    }
+
+    std::string Metrics::render(const Snapshot& snapshot) {
+        std::ostringstream out;
+
+        counter(out, "echo_connections", "Currently open echo connections", snapshot.connections, "gauge");
+        counter(out, "echo_connections_total", "Echo connections opened since start", snapshot.connectionsTotal);
+        counter(out, "echo_messages_received_total", "Messages received from clients", snapshot.total.messagesIn);
+        counter(out, "echo_bytes_received_total", "Payload bytes received from clients", snapshot.total.bytesIn);
+        counter(out, "echo_messages_sent_total", "Messages sent to clients", snapshot.total.messagesOut);
+        counter(out, "echo_bytes_sent_total", "Payload bytes sent to clients", snapshot.total.bytesOut);
+        counter(out, "echo_coalesced_writes_total", "Batches of pre-encoded frames handed to the socket", snapshot.total.writes);
+        counter(out, "echo_upgrades_total", "Successful websocket upgrades", snapshot.upgrades);
+        counter(out, "echo_upgrade_failures_total", "Failed websocket upgrades", snapshot.upgradeFailures);
+        counter(out, "echo_tls_handshakes_total", "Completed TLS handshakes", snapshot.tlsHandshakes);
+        counter(out, "echo_tls_resumptions_total", "TLS handshakes resuming a session from the cache or a ticket", snapshot.tlsResumptions);
+        counter(out, "echo_ping_timeouts_total", "Connections closed as no pong arrived within ECHO_PING_TIMEOUT", snapshot.pingTimeouts);
+        counter(out, "echo_invalid_utf8_total", "Text messages rejected with 1007 for invalid UTF-8", snapshot.invalidUtf8);
+        counter(out, "echo_buffer_pool_hits_total", "Message buffers served from the pool", snapshot.bufferPoolHits);
+        counter(out, "echo_buffer_pool_misses_total", "Message buffers newly allocated", snapshot.bufferPoolMisses);
+        counter(out, "echo_buffer_pool_cached_bytes", "Memory held by idle pooled buffers", snapshot.bufferPoolCachedBytes, "gauge");
+        counter(out, "echo_relay_drops_total", "Broadcasts not relayed to a worker which fell behind", snapshot.relayDrops);
+        counter(out, "echo_congestions_total", "Connections whose outbound backlog crossed the high water mark", snapshot.congestions);
+        counter(out, "echo_overflow_dropped_total", "Messages not delivered to congested connections", snapshot.overflowDropped);
+        counter(out, "echo_overflow_superseded_total", "Kept back messages replaced by a newer one", snapshot.overflowSuperseded);
+        counter(out, "echo_overflow_closed_total", "Connections closed with 1008 because of congestion", snapshot.overflowClosed);
+        counter(out,
+                "echo_idle_connections",
+                "Connections whose buffers are released after ECHO_IDLE_COMPACT",
+                snapshot.idleConnections,
+                "gauge");
+        counter(out, "echo_idle_compactions_total", "Idle connections compacted", snapshot.compactions);
+        counter(out, "echo_offloaded_messages_total", "Messages processed by the offload worker threads", snapshot.offloaded);
+        counter(out,
+                "echo_offload_fallbacks_total",
+                "Large messages processed inline as the offload queues were full",
+                snapshot.offloadFallbacks);
+        counter(out, "echo_resident_bytes", "Resident memory of the server processes", snapshot.residentBytes, "gauge");
+
+        out << "# HELP echo_broadcast_fanout Number of recipients per broadcast\n";
+        out << "# TYPE echo_broadcast_fanout histogram\n";
+        uint64_t cumulative = 0;
+        for (std::size_t bucket = 0; bucket < fanOutBounds.size(); bucket++) {
+            cumulative += snapshot.fanOutBuckets[bucket];
+            out << "echo_broadcast_fanout_bucket{le=\"" << fanOutBounds[bucket] << "\"} " << cumulative << "\n";
+        }
+        out << "echo_broadcast_fanout_bucket{le=\"+Inf\"} " << snapshot.broadcasts << "\n";
+        out << "echo_broadcast_fanout_sum " << snapshot.fanOutSum << "\n";
+        out << "echo_broadcast_fanout_count " << snapshot.broadcasts << "\n";
+
+        return out.str();
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
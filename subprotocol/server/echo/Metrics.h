@@ -0,0 +1,139 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_METRICS_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_METRICS_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <array>         // for array
+#include <cstddef>       // for std::size_t
+#include <cstdint>       // for uint64_t
+#include <string>        // for string
+#include <unordered_set> // for unordered_set
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Traffic metrics of the echo subprotocol. Each connection owns its Counters and bumps them with plain
+     * increments on the hot path; they are only summed up when scraped. Counters of closed connections are
+     * folded into 'retired' on disconnect.
+     */
+    class Metrics {
+    public:
+        // Upper bounds of the broadcast fan-out histogram buckets
+        static constexpr std::array<uint64_t, 6> fanOutBounds{1, 10, 100, 1000, 10000, 100000};
+
+        struct Counters {
+            uint64_t messagesIn = 0;
+            uint64_t bytesIn = 0;
+            uint64_t messagesOut = 0;
+            uint64_t bytesOut = 0;
+            uint64_t writes = 0;
+
+            Counters& operator+=(const Counters& counters);
+        };
+
+        // Everything render() reports at one point in time. Snapshots of several worker processes (ShardGroup) add up
+        // to the metrics of the whole server, gauges included. Consists of uint64_t members only.
+        struct Snapshot {
+            Counters total;
+            uint64_t connections = 0;
+            uint64_t connectionsTotal = 0;
+            uint64_t upgrades = 0;
+            uint64_t upgradeFailures = 0;
+            uint64_t tlsHandshakes = 0;
+            uint64_t tlsResumptions = 0;
+            uint64_t pingTimeouts = 0;
+            uint64_t invalidUtf8 = 0;
+            uint64_t bufferPoolHits = 0;
+            uint64_t bufferPoolMisses = 0;
+            uint64_t bufferPoolCachedBytes = 0;
+            uint64_t relayDrops = 0;
+            uint64_t congestions = 0;
+            uint64_t overflowDropped = 0;
+            uint64_t overflowSuperseded = 0;
+            uint64_t overflowClosed = 0;
+            uint64_t idleConnections = 0;
+            uint64_t compactions = 0;
+            uint64_t offloaded = 0;
+            uint64_t offloadFallbacks = 0;
+            uint64_t residentBytes = 0;
+            std::array<uint64_t, fanOutBounds.size() + 1> fanOutBuckets{};
+            uint64_t fanOutSum = 0;
+            uint64_t broadcasts = 0;
+
+            Snapshot& operator+=(const Snapshot& snapshot);
+        };
+
+        static constexpr std::size_t SNAPSHOT_FIELDS = sizeof(Snapshot) / sizeof(uint64_t);
+
+        static Metrics& instance();
+
+        void attach(const Counters* counters);
+        void detach(const Counters* counters);
+
+        void broadcast(std::size_t fanOut);
+
+        [[nodiscard]] std::size_t connections() const;
+
+        [[nodiscard]] Snapshot snapshot() const;
+
+        // Prometheus text exposition format (version 0.0.4)
+        [[nodiscard]] std::string render() const;
+        [[nodiscard]] static std::string render(const Snapshot& snapshot);
+
+        uint64_t connectionsTotal = 0;
+        uint64_t upgrades = 0;
+        uint64_t upgradeFailures = 0;
+        uint64_t relayDrops = 0;
+        uint64_t invalidUtf8 = 0;
+        uint64_t tlsHandshakes = 0;
+        uint64_t tlsResumptions = 0;
+        uint64_t pingTimeouts = 0;
+
+        // Outbound backpressure: high water mark crossings and the overflow policy applied afterwards
+        uint64_t congestions = 0;
+        uint64_t overflowDropped = 0;
+        uint64_t overflowSuperseded = 0;
+        uint64_t overflowClosed = 0;
+
+        // Idle compaction: connections currently compacted and compactions since start
+        uint64_t idleConnections = 0;
+        uint64_t compactions = 0;
+
+        // Worker thread offload: messages processed by the workers and large ones processed inline as all queues were full
+        uint64_t offloaded = 0;
+        uint64_t offloadFallbacks = 0;
+
+    private:
+        Metrics() = default;
+
+        std::unordered_set<const Counters*> live;
+        Counters retired;
+
+        std::array<uint64_t, fanOutBounds.size() + 1> fanOutBuckets{};
+        uint64_t fanOutSum = 0;
+        uint64_t broadcasts = 0;
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_METRICS_H
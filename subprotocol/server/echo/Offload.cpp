@@ -0,0 +1,254 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Offload.h"
+
+#include <core/eventreceiver/ReadEventReceiver.h>
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <atomic>
+#include <cerrno>
+#include <log/Logger.h>
+#include <new>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    static void notify(int fd) {
+        uint64_t one = 1;
+        if (write(fd, &one, sizeof(one)) < 0) {
+            PLOG(ERROR) << "Offload: eventfd";
+        }
+    }
+
+    // Bounded SPSC ring of job pointers. Head and tail sit on cache lines of their own to keep producer and consumer
+    // from invalidating each other.
+    class Offload::Queue {
+    public:
+        explicit Queue(std::size_t capacity)
+            : slots(capacity + 1) {
+        }
+
+        bool push(Job* job) {
+            std::size_t tail = this->tail.load(std::memory_order_relaxed);
+            std::size_t following = (tail + 1) % slots.size();
+
+            if (following == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            slots[tail] = job;
+            this->tail.store(following, std::memory_order_release);
+
+            return true;
+        }
+
+        Job* pop() {
+            std::size_t head = this->head.load(std::memory_order_relaxed);
+
+            if (head == tail.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            Job* job = slots[head];
+            this->head.store((head + 1) % slots.size(), std::memory_order_release);
+
+            return job;
+        }
+
+    private:
+        std::vector<Job*> slots;
+
+        alignas(64) std::atomic<std::size_t> head = 0;
+        alignas(64) std::atomic<std::size_t> tail = 0;
+    };
+
+    struct Offload::Worker {
+        Worker(std::size_t capacity, int done)
+            : submitted(capacity)
+            , finished(capacity)
+            , wakeup(eventfd(0, EFD_CLOEXEC))
+            , done(done) {
+        }
+
+        ~Worker() {
+            while (Job* job = submitted.pop()) {
+                delete job;
+            }
+            while (Job* job = finished.pop()) {
+                delete job;
+            }
+
+            close(wakeup);
+        }
+
+        void run() {
+            while (!stopping.load(std::memory_order_acquire)) {
+                uint64_t count = 0;
+                if (read(wakeup, &count, sizeof(count)) < 0 && errno != EINTR) {
+                    PLOG(ERROR) << "Offload: eventfd";
+                    break;
+                }
+
+                while (Job* job = submitted.pop()) {
+                    job->run();
+                    finished.push(job);
+                    notify(done);
+                }
+            }
+        }
+
+        void wake() {
+            notify(wakeup);
+        }
+
+        Queue submitted;
+        Queue finished;
+        int wakeup;
+        int done;
+
+        std::size_t jobs = 0; // In flight, only touched by the event loop thread
+        std::atomic<bool> stopping = false;
+        std::thread thread;
+    };
+
+    // Reads 'done' on the event loop thread. It outlives the offload if the event loop still has it registered, and the
+    // event loop also lets go of every descriptor still enabled when it terminates.
+    class Offload::Collector : public core::eventreceiver::ReadEventReceiver {
+    public:
+        Collector(Offload* offload, int fd)
+            : core::eventreceiver::ReadEventReceiver("Offload", TIMEOUT::DISABLE)
+            , offload(offload)
+            , fd(fd) {
+        }
+
+        void detach() {
+            offload = nullptr;
+        }
+
+    private:
+        void readEvent() override {
+            uint64_t count = 0;
+            if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                PLOG(ERROR) << "Offload: eventfd";
+            }
+
+            if (offload != nullptr) {
+                offload->collect();
+            }
+        }
+
+        void unobservedEvent() override {
+            if (offload != nullptr) {
+                offload->collector = nullptr;
+            }
+
+            delete this;
+        }
+
+        Offload* offload;
+        int fd;
+    };
+
+    Offload::Offload(std::size_t threads, std::size_t capacity)
+        : capacity(capacity)
+        , done(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (done < 0) {
+            PLOG(ERROR) << "Offload: eventfd";
+            threads = 0;
+        } else {
+            collector = new Collector(this, done);
+            collector->enable(done);
+        }
+
+        for (std::size_t i = 0; i < threads; i++) {
+            std::unique_ptr<Worker> worker = std::make_unique<Worker>(capacity, done);
+
+            if (worker->wakeup < 0) {
+                PLOG(ERROR) << "Offload: eventfd";
+                break;
+            }
+
+            worker->thread = std::thread(&Worker::run, worker.get());
+            workers.push_back(std::move(worker));
+        }
+
+        LOG(INFO) << "Offload: " << workers.size() << " worker threads";
+    }
+
+    Offload::~Offload() {
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            worker->stopping.store(true, std::memory_order_release);
+            worker->wake();
+        }
+
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            worker->thread.join();
+        }
+
+        // Usually destroyed after the event loop has gone, which has already let go of the collector
+        if (collector != nullptr) {
+            collector->detach();
+            collector->disable();
+        }
+
+        if (done >= 0) {
+            close(done);
+        }
+    }
+
+    bool Offload::submit(std::unique_ptr<Job>& job) {
+        for (std::size_t tried = 0; tried < workers.size(); tried++) {
+            Worker& worker = *workers[next];
+            next = (next + 1) % workers.size();
+
+            if (worker.jobs < capacity && worker.submitted.push(job.get())) {
+                job.release();
+
+                worker.jobs++;
+                jobs++;
+                worker.wake();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::size_t Offload::inFlight() const {
+        return jobs;
+    }
+
+    void Offload::collect() {
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            while (Job* job = worker->finished.pop()) {
+                worker->jobs--;
+                jobs--;
+
+                std::unique_ptr<Job>(job)->complete();
+            }
+        }
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
@@ -0,0 +1,91 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_OFFLOAD_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_OFFLOAD_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef>  // for std::size_t
+#include <cstdint>  // for uint64_t
+#include <memory>   // for unique_ptr
+#include <vector>   // for vector
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Bounded pool of worker threads for CPU heavy per message work, so that a large message does not stall every other
+     * connection of the event loop.
+     *
+     * Every worker owns two lock-free single-producer single-consumer queues: jobs go from the event loop thread to the
+     * worker, which sleeps on an eventfd while it has nothing to do, and finished jobs go back. Workers signal every
+     * finished job on a second eventfd which the event loop observes, thus a job completes as soon as it is done rather
+     * than on the next tick of a timer. A worker never has more jobs than its queue capacity, thus the return queue can
+     * not overflow.
+     *
+     * Offload does not order jobs: a submitter which needs ordering keeps at most one job in flight.
+     */
+    class Offload {
+    public:
+        class Job {
+        public:
+            Job() = default;
+            virtual ~Job() = default;
+
+            Job(const Job&) = delete;
+            Job& operator=(const Job&) = delete;
+
+            // On a worker thread: must only touch the job's own data and thread safe code
+            virtual void run() = 0;
+
+            // Back on the event loop thread. The job is deleted afterwards.
+            virtual void complete() = 0;
+        };
+
+        Offload(std::size_t threads, std::size_t capacity);
+        ~Offload();
+
+        Offload(const Offload&) = delete;
+        Offload& operator=(const Offload&) = delete;
+
+        // Takes over 'job' and returns true, or returns false and leaves it with the caller if every queue is full
+        bool submit(std::unique_ptr<Job>& job);
+
+        [[nodiscard]] std::size_t inFlight() const;
+
+    private:
+        class Queue;
+        struct Worker;
+        class Collector;
+
+        void collect();
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::size_t capacity;
+        std::size_t next = 0;
+        std::size_t jobs = 0;
+
+        int done = -1;                  // Signaled by the workers for every finished job
+        Collector* collector = nullptr; // Deletes itself once the event loop has let go of it
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_OFFLOAD_H
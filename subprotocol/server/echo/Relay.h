@@ -0,0 +1,54 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_RELAY_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_RELAY_H
+
+namespace web::websocket::subprotocol::echo::server {
+    class Frame;
+} // namespace web::websocket::subprotocol::echo::server
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <memory> // for shared_ptr
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Forwards broadcasts to echo instances outside of this event loop (e.g. other worker processes). The receiving
+     * side hands the messages to Echo::broadcastRelayed(). Only complete messages are published; the frame is shared so
+     * that a relay can hold on to it until every receiver has taken it.
+     */
+    class Relay {
+    public:
+        virtual ~Relay() = default;
+
+        virtual void publish(const std::shared_ptr<const Frame>& frame) = 0;
+
+        static void install(Relay* relay);
+        static Relay* installed();
+
+    private:
+        static Relay* relay;
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_RELAY_H
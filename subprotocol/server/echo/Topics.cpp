@@ -0,0 +1,75 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Topics.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    void Topics::subscribe(const std::string& topic, Echo* echo) {
+        if (memberships[echo].insert(topic).second) {
+            index[topic].insert(echo);
+        }
+    }
+
+    void Topics::unsubscribe(const std::string& topic, Echo* echo) {
+        auto membership = memberships.find(echo);
+
+        if (membership != memberships.end() && membership->second.erase(topic) > 0) {
+            if (membership->second.empty()) {
+                memberships.erase(membership);
+            }
+
+            auto subscribers = index.find(topic);
+            subscribers->second.erase(echo);
+            if (subscribers->second.empty()) {
+                index.erase(subscribers);
+            }
+        }
+    }
+
+    void Topics::unsubscribeAll(Echo* echo) {
+        auto membership = memberships.find(echo);
+
+        if (membership != memberships.end()) {
+            for (const std::string& topic : membership->second) {
+                auto subscribers = index.find(topic);
+                subscribers->second.erase(echo);
+                if (subscribers->second.empty()) {
+                    index.erase(subscribers);
+                }
+            }
+
+            memberships.erase(membership);
+        }
+    }
+
+    const Topics::Subscribers* Topics::subscribers(std::string_view topic) const {
+        auto subscribers = index.find(topic);
+
+        return subscribers != index.end() ? &subscribers->second : nullptr;
+    }
+
+    std::size_t Topics::size() const {
+        return index.size();
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
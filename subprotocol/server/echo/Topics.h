@@ -0,0 +1,68 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_TOPICS_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_TOPICS_H
+
+namespace web::websocket::subprotocol::echo::server {
+    class Echo;
+} // namespace web::websocket::subprotocol::echo::server
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef>       // for std::size_t
+#include <functional>    // for equal_to, hash
+#include <string>        // for string
+#include <string_view>   // for string_view
+#include <unordered_map> // for unordered_map
+#include <unordered_set> // for unordered_set
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Subscription index of the "pubsub" flavour of the echo subprotocol. Both directions are hashed: subscribing and
+     * unsubscribing are O(1), a publish touches the subscribers of its topic only, and a closing connection leaves
+     * exactly the topics it had joined.
+     */
+    class Topics {
+    public:
+        using Subscribers = std::unordered_set<Echo*>;
+
+        void subscribe(const std::string& topic, Echo* echo);
+        void unsubscribe(const std::string& topic, Echo* echo);
+        void unsubscribeAll(Echo* echo);
+
+        // nullptr if the topic has no subscribers
+        [[nodiscard]] const Subscribers* subscribers(std::string_view topic) const;
+
+        [[nodiscard]] std::size_t size() const;
+
+    private:
+        struct Hash : std::hash<std::string_view> {
+            using is_transparent = void;
+        };
+
+        std::unordered_map<std::string, Subscribers, Hash, std::equal_to<>> index;
+        std::unordered_map<Echo*, std::unordered_set<std::string>> memberships;
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_TOPICS_H
@@ -0,0 +1,348 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Utf8Validator.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86
+#endif
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    namespace {
+
+        /*
+         * A vector kernel validates whole vectors of a range which starts at a character boundary. A sequence left open
+         * at the end of the range is not an error yet: it is completed by the scalar state machine.
+         */
+        struct Kernel {
+            const char* name;
+            std::size_t width;
+            bool (*validate)(const uint8_t* data, std::size_t length);
+        };
+
+#ifdef UTF8_X86
+
+        // Error classes of the lookup algorithm, each bit is set by the three table lookups of one byte pair
+        constexpr uint8_t TOO_SHORT = 1 << 0;
+        constexpr uint8_t TOO_LONG = 1 << 1;
+        constexpr uint8_t OVERLONG_3 = 1 << 2;
+        constexpr uint8_t TOO_LARGE = 1 << 3;
+        constexpr uint8_t SURROGATE = 1 << 4;
+        constexpr uint8_t OVERLONG_2 = 1 << 5;
+        constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+        constexpr uint8_t OVERLONG_4 = 1 << 6;
+        constexpr uint8_t TWO_CONTS = 1 << 7;
+        constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+        // Indexed by the high nibble of the first byte of a pair
+        alignas(16) constexpr uint8_t byte1High[16] = {
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TOO_LONG,
+            TWO_CONTS,
+            TWO_CONTS,
+            TWO_CONTS,
+            TWO_CONTS,
+            TOO_SHORT | OVERLONG_2,
+            TOO_SHORT,
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        };
+
+        // Indexed by the low nibble of the first byte of a pair
+        alignas(16) constexpr uint8_t byte1Low[16] = {
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY,
+            CARRY,
+            CARRY | TOO_LARGE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+        };
+
+        // Indexed by the high nibble of the second byte of a pair
+        alignas(16) constexpr uint8_t byte2High[16] = {
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+            TOO_SHORT,
+        };
+
+        // Subtracted with saturation from the last three bytes: non-zero if a sequence is still open
+        alignas(32) constexpr uint8_t incompleteBounds[32] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF,
+        };
+
+        __attribute__((target("avx2"))) bool validateAvx2(const uint8_t* data, std::size_t length) {
+            const __m256i b1High = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1High)));
+            const __m256i b1Low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1Low)));
+            const __m256i b2High = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(byte2High)));
+            const __m256i bounds = _mm256_load_si256(reinterpret_cast<const __m256i*>(incompleteBounds));
+            const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+            __m256i previous = _mm256_setzero_si256();
+            __m256i incomplete = _mm256_setzero_si256();
+            __m256i error = _mm256_setzero_si256();
+
+            for (std::size_t offset = 0; offset + 32 <= length; offset += 32) {
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+
+                if (_mm256_movemask_epi8(input) == 0) { // ASCII only: just an open sequence before is an error
+                    error = _mm256_or_si256(error, incomplete);
+                    incomplete = _mm256_setzero_si256();
+                } else {
+                    // The input shifted by one, two and three bytes, continued from the previous vector
+                    __m256i carried = _mm256_permute2x128_si256(previous, input, 0x21);
+                    __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+                    __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+                    __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+
+                    __m256i special = _mm256_and_si256(
+                        _mm256_and_si256(_mm256_shuffle_epi8(b1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                                         _mm256_shuffle_epi8(b1Low, _mm256_and_si256(prev1, nibble))),
+                        _mm256_shuffle_epi8(b2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+                    // Third and fourth bytes of a sequence have to be continuations: bit 7 set
+                    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+                    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+                    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+                    error = _mm256_or_si256(error, _mm256_xor_si256(must23, special));
+                    incomplete = _mm256_subs_epu8(input, bounds);
+                }
+
+                previous = input;
+            }
+
+            return _mm256_testz_si256(error, error) != 0;
+        }
+
+        __attribute__((target("ssse3,sse4.1"))) bool validateSsse3(const uint8_t* data, std::size_t length) {
+            const __m128i b1High = _mm_load_si128(reinterpret_cast<const __m128i*>(byte1High));
+            const __m128i b1Low = _mm_load_si128(reinterpret_cast<const __m128i*>(byte1Low));
+            const __m128i b2High = _mm_load_si128(reinterpret_cast<const __m128i*>(byte2High));
+            const __m128i bounds = _mm_load_si128(reinterpret_cast<const __m128i*>(incompleteBounds + 16));
+            const __m128i nibble = _mm_set1_epi8(0x0F);
+
+            __m128i previous = _mm_setzero_si128();
+            __m128i incomplete = _mm_setzero_si128();
+            __m128i error = _mm_setzero_si128();
+
+            for (std::size_t offset = 0; offset + 16 <= length; offset += 16) {
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+
+                if (_mm_movemask_epi8(input) == 0) {
+                    error = _mm_or_si128(error, incomplete);
+                    incomplete = _mm_setzero_si128();
+                } else {
+                    __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+                    __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+                    __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+
+                    __m128i special =
+                        _mm_and_si128(_mm_and_si128(_mm_shuffle_epi8(b1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                                                    _mm_shuffle_epi8(b1Low, _mm_and_si128(prev1, nibble))),
+                                      _mm_shuffle_epi8(b2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+                    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+                    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+                    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+
+                    error = _mm_or_si128(error, _mm_xor_si128(must23, special));
+                    incomplete = _mm_subs_epu8(input, bounds);
+                }
+
+                previous = input;
+            }
+
+            return _mm_testz_si128(error, error) != 0;
+        }
+
+#endif // UTF8_X86
+
+        // The best kernel the CPU supports, ECHO_UTF8_KERNEL=ssse3|scalar caps the choice (for comparison)
+        Kernel selectKernel() {
+#ifdef UTF8_X86
+            const char* cap = std::getenv("ECHO_UTF8_KERNEL");
+            std::string_view limit = cap != nullptr ? cap : "avx2";
+
+            __builtin_cpu_init();
+
+            if (limit == "avx2" && __builtin_cpu_supports("avx2")) {
+                return {"avx2", 32, validateAvx2};
+            }
+            if (limit != "scalar" && __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1")) {
+                return {"ssse3", 16, validateSsse3};
+            }
+#endif
+            return {"scalar", 0, nullptr};
+        }
+
+        const Kernel& kernel() {
+            static const Kernel kernel = selectKernel();
+
+            return kernel;
+        }
+
+    } // namespace
+
+    bool Utf8Validator::step(uint8_t byte) {
+        if (need > 0) {
+            if (byte < lower || byte > upper) {
+                return false;
+            }
+
+            need--;
+            lower = 0x80;
+            upper = 0xBF;
+        } else if (byte >= 0x80) {
+            // Second byte ranges exclude overlongs (E0, F0), surrogates (ED) and code points above U+10FFFF (F4)
+            if (byte >= 0xC2 && byte <= 0xDF) {
+                need = 1;
+            } else if (byte >= 0xE0 && byte <= 0xEF) {
+                need = 2;
+                lower = byte == 0xE0 ? 0xA0 : 0x80;
+                upper = byte == 0xED ? 0x9F : 0xBF;
+            } else if (byte >= 0xF0 && byte <= 0xF4) {
+                need = 3;
+                lower = byte == 0xF0 ? 0x90 : 0x80;
+                upper = byte == 0xF4 ? 0x8F : 0xBF;
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Utf8Validator::scalar(const uint8_t* data, std::size_t length) {
+        const uint8_t* end = data + length;
+
+        while (data < end) {
+            if (need == 0 && end - data >= 8) { // Skip ASCII a word at a time
+                uint64_t word = 0;
+                std::memcpy(&word, data, sizeof(word));
+
+                if ((word & 0x8080808080808080) == 0) {
+                    data += sizeof(word);
+                    continue;
+                }
+            }
+
+            if (!step(*data++)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Utf8Validator::feed(const char* data, std::size_t length) {
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* end = begin + length;
+
+        // Complete a sequence left open by the previous fragment
+        while (need > 0 && begin < end) {
+            if (!step(*begin++)) {
+                return false;
+            }
+        }
+
+        const Kernel& vector = server::kernel();
+
+        if (vector.validate != nullptr && static_cast<std::size_t>(end - begin) >= vector.width) {
+            std::size_t bulk = static_cast<std::size_t>(end - begin) / vector.width * vector.width;
+
+            if (!vector.validate(begin, bulk)) {
+                return false;
+            }
+
+            // A sequence open at the end of the bulk is checked again, byte by byte, from its lead byte on
+            const uint8_t* tail = begin + bulk;
+            for (std::size_t back = 1; back <= 3; back++) {
+                uint8_t byte = tail[-static_cast<std::ptrdiff_t>(back)];
+
+                if (byte >= 0xC0) {
+                    std::size_t sequence = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+                    if (sequence > back) {
+                        tail -= back;
+                    }
+                    break;
+                } else if (byte < 0x80) {
+                    break;
+                }
+            }
+
+            begin = tail;
+        }
+
+        return scalar(begin, static_cast<std::size_t>(end - begin));
+    }
+
+    bool Utf8Validator::complete() const {
+        return need == 0;
+    }
+
+    void Utf8Validator::reset() {
+        need = 0;
+        lower = 0x80;
+        upper = 0xBF;
+    }
+
+    const char* Utf8Validator::kernel() {
+        return server::kernel().name;
+    }
+
+} // namespace web::websocket::subprotocol::echo::server
@@ -0,0 +1,64 @@
+/*
+ * snode.c - a slim toolkit for network communication
+ * Copyright (C) 2020, 2021, 2022 Volker Christian <me@vchrist.at>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_UTF8VALIDATOR_H
+#define WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_UTF8VALIDATOR_H
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#include <cstddef> // for std::size_t
+#include <cstdint> // for uint8_t
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+namespace web::websocket::subprotocol::echo::server {
+
+    /*
+     * Incremental UTF-8 validation (RFC 3629) of text messages arriving in arbitrary fragments.
+     *
+     * The bulk of each fragment is checked with the vectorized lookup algorithm of Keiser and Lemire ("Validating UTF-8
+     * In Less Than One Instruction Per Byte", 2021) using AVX2 or SSSE3, whichever the CPU supports, and with a scalar
+     * state machine otherwise. The scalar state machine also handles the few bytes around fragment boundaries, thus a
+     * multi-byte sequence may be split anywhere.
+     */
+    class Utf8Validator {
+    public:
+        // Returns false as soon as the text received so far can not be the beginning of valid UTF-8
+        bool feed(const char* data, std::size_t length);
+
+        // True if no multi-byte sequence is left open at the end of the message
+        [[nodiscard]] bool complete() const;
+
+        void reset();
+
+        // Name of the kernel selected for this CPU: "avx2", "ssse3" or "scalar"
+        static const char* kernel();
+
+    private:
+        bool step(uint8_t byte);
+        bool scalar(const uint8_t* data, std::size_t length);
+
+        // Continuation bytes still expected and the admissible range of the next one
+        uint8_t need = 0;
+        uint8_t lower = 0x80;
+        uint8_t upper = 0xBF;
+    };
+
+} // namespace web::websocket::subprotocol::echo::server
+
+#endif // WEB_WEBSOCKET_SUBPROTOCOL_ECHO_SERVER_UTF8VALIDATOR_H